@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -21,12 +22,78 @@
 //타이머 인터럽트가 발생할 때마다 증가되는 시스템 시간을 추적하기 위해 사용
 //보통 시스템이 시작된 이후의 틱 수를 나타냄
 static int64_t ticks;
+static struct seqlock ticks_seq;        /* Protects `ticks'. */
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Hierarchical timer wheel holding pending timer events.
+
+   Level 0 has one slot per tick and covers the next 256 ticks
+   (a few seconds).  Each slot of level N >= 1 covers the whole
+   span of level N - 1, so levels 1, 2 and 3 cover roughly
+   minutes, hours and days.  Adding or cancelling an event is
+   O(1).  Whenever level 0 wraps around, the next slot of level 1
+   is cascaded, i.e. its events are re-inserted into level 0 (and
+   likewise up the hierarchy), so each event is moved at most
+   WHEEL_LEVELS - 1 times before it fires. */
+#define WHEEL0_BITS 8
+#define WHEELN_BITS 6
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_SPAN(LEVEL) (1LL << (WHEEL0_BITS + WHEELN_BITS * (LEVEL)))
+
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheeln[WHEEL_LEVELS - 1][WHEELN_SIZE];
+static struct spinlock wheel_lock;      /* Protects the wheel. */
+
+/* Next tick the wheel will process.  Only ever behind `ticks'
+   while the timer interrupt is running. */
+static int64_t wheel_tick;
+
+/* Interrupt handler statistics. */
+static struct timer_irq_stats irq_stats;
+
+/* Tickless idle.
+
+   When the idle thread is about to halt and no timer event is due
+   on the next tick, timer_idle_enter() reprograms the PIT as a
+   one-shot timer for the next deadline instead of taking an
+   interrupt every tick.  The one-shot is timed from the last tick
+   boundary, not from when it is armed, so the part of the
+   current tick that already went by is not lost.  The 8254
+   counter is only 16 bits wide, so a one-shot ends at most 0xffff
+   input clocks (55 ms) after it is armed, i.e. after about 5 ticks
+   at 100 Hz; longer idle periods would need another timer, such
+   as the local APIC's.
+
+   The first interrupt of any kind ends the idle period:
+   timer_idle_exit() reads back how much time went by and replays
+   the missed ticks.  An early wake-up leaves the clock partway
+   into a tick, so the one-shot is rearmed for the rest of it, and
+   periodic mode resumes only once that tick's interrupt arrives.
+   `ticks' thus keeps pace with the PIT. */
+#define PIT_HZ 1193180
+#define PIT_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+static int idle_oneshot_ticks;  /* Ticks from the last tick boundary to the
+                                   end of the armed one-shot, 0 if none. */
+static unsigned idle_phase;     /* PIT clocks from the last tick boundary to
+                                   when the one-shot was armed. */
+static int64_t skipped_ticks;   /* Ticks replayed without an interrupt. */
+
 static intr_handler_func timer_interrupt;
+static void wheel_insert (struct timer_event *);
+static void wheel_cascade (int level, int idx);
+static void wheel_run (void);
+static int64_t wheel_next_due (int max);
+static void pit_set_periodic (void);
+static void pit_set_oneshot (uint16_t count);
+static unsigned pit_periodic_phase (void);
+static void tick (void);
+static timer_event_func wake_sleeper;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -36,14 +103,16 @@ static void real_time_sleep (int64_t num, int32_t denom);
    corresponding interrupt. */
 void
 timer_init (void) {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
 	//주어진 주기마다 인터럽트 발생
-	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary.*/
-	outb (0x40, count & 0xff);	//PIT 주기 설정
-	outb (0x40, count >> 8);
+	pit_set_periodic ();
+
+	seqlock_init (&ticks_seq);
+	spin_lock_init (&wheel_lock, "timer wheel");
+	for (int i = 0; i < WHEEL0_SIZE; i++)
+		list_init (&wheel0[i]);
+	for (int level = 0; level < WHEEL_LEVELS - 1; level++)
+		for (int i = 0; i < WHEELN_SIZE; i++)
+			list_init (&wheeln[level][i]);
 
 	intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -76,10 +145,13 @@ timer_calibrate (void) {
 /* Returns the number of timer ticks since the OS booted. */
 int64_t
 timer_ticks (void) {
-	enum intr_level old_level = intr_disable ();
-	int64_t t = ticks;
-	intr_set_level (old_level);
-	barrier ();
+	unsigned seq;
+	int64_t t;
+
+	do {
+		seq = seqlock_read_begin (&ticks_seq);
+		t = ticks;
+	} while (seqlock_read_retry (&ticks_seq, seq));
 	return t;
 }
 
@@ -94,16 +166,30 @@ timer_elapsed (int64_t then) {
 void
 timer_sleep (int64_t ticks) {
 	int64_t start = timer_ticks ();	//현재 시간 기록
-	
+	struct timer_event wakeup;
+	enum intr_level old_level;
+
 	ASSERT (intr_get_level () == INTR_ON);	
 
-	/* busy waits */ 
-	// while (timer_elapsed (start) < ticks) // 경과 시간 계산해주고, 틱(주어진 시간)보다 작을 때까지 계속해서 cpu양보 
-	// 	thread_yield ();
-	
 	/* Alarm Clock */
-	if(timer_elapsed(start) < ticks)
-		thread_sleep(start + ticks);
+	//깨어날 시각에 현재 스레드를 unblock하는 타이머를 걸고 block된다.
+	if (ticks <= 0)
+		return;
+	timer_event_init (&wakeup, wake_sleeper, thread_current ());
+	old_level = intr_disable ();
+	timer_event_add (&wakeup, start + ticks);
+	thread_block ();
+	intr_set_level (old_level);
+}
+
+/* Timer event callback used by timer_sleep(). */
+static void
+wake_sleeper (void *t_) {
+	struct thread *t = t_;
+
+	thread_unblock (t);
+	if (t->priority > thread_current ()->priority)
+		intr_yield_on_return ();
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -124,21 +210,330 @@ timer_nsleep (int64_t ns) {
 	real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes timer event EVENT to call FUNC with AUX when it
+   expires.  The event is not pending until timer_event_add(). */
+void
+timer_event_init (struct timer_event *event, timer_event_func *func,
+		void *aux) {
+	ASSERT (event != NULL);
+	ASSERT (func != NULL);
+
+	event->expires = 0;
+	event->func = func;
+	event->aux = aux;
+	event->pending = false;
+}
+
+/* Arms EVENT to fire at absolute tick EXPIRES.  An expiry that is
+   already in the past fires on the next tick.  EVENT must not be
+   pending.
+
+   This function may be called from an interrupt handler. */
+void
+timer_event_add (struct timer_event *event, int64_t expires) {
+	enum intr_level old_level;
+
+	ASSERT (event != NULL);
+
+	old_level = spin_lock_irqsave (&wheel_lock);
+	ASSERT (!event->pending);
+	event->expires = expires;
+	event->pending = true;
+	wheel_insert (event);
+	spin_unlock_irqrestore (&wheel_lock, old_level);
+}
+
+/* Disarms EVENT.  Returns true if it was pending, false if it
+   had already fired or was never added.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_event_cancel (struct timer_event *event) {
+	enum intr_level old_level;
+	bool was_pending;
+
+	ASSERT (event != NULL);
+
+	old_level = spin_lock_irqsave (&wheel_lock);
+	was_pending = event->pending;
+	if (was_pending) {
+		list_remove (&event->elem);
+		event->pending = false;
+	}
+	spin_unlock_irqrestore (&wheel_lock, old_level);
+	return was_pending;
+}
+
+/* Called by the idle thread, with interrupts off, right before
+   it halts the CPU.  If nothing is due on the next tick, stops
+   the periodic timer interrupt until the next pending event. */
+void
+timer_idle_enter (void) {
+	unsigned phase;
+	int64_t due;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (idle_oneshot_ticks != 0)
+		return;
+	phase = pit_periodic_phase ();
+	spin_lock (&wheel_lock);
+	due = wheel_next_due ((0xffff + phase) / PIT_COUNT);
+	spin_unlock (&wheel_lock);
+	if (due <= 1)
+		return;
+
+	idle_oneshot_ticks = due;
+	idle_phase = phase;
+	pit_set_oneshot (due * PIT_COUNT - phase);
+}
+
+/* Ends a tickless idle period, if one is in progress: brings
+   `ticks', the thread statistics and the timer wheel up to date
+   and restores the periodic timer interrupt.  Called at the start
+   of every external interrupt. */
+void
+timer_idle_exit (void) {
+	uint8_t status;
+	unsigned armed, remaining, elapsed;
+	int64_t missed;
+
+	ASSERT (intr_context ());
+
+	if (idle_oneshot_ticks == 0)
+		return;
+
+	/* Read-back command: latch status and count of counter 0.  The
+	   OUT pin goes high once a mode 0 count reaches zero.  Until the
+	   count is loaded (NULL COUNT), none of it has gone by. */
+	outb (0x43, 0xc2);
+	status = inb (0x40);
+	remaining = inb (0x40);
+	remaining |= inb (0x40) << 8;
+	armed = idle_oneshot_ticks * PIT_COUNT - idle_phase;
+	if (status & 0x40 || remaining > armed)
+		remaining = armed;
+
+	if (status & 0x80) {
+		/* The one-shot expired.  Its interrupt, pending or being
+		   handled right now, accounts for the last tick. */
+		missed = idle_oneshot_ticks - 1;
+		idle_oneshot_ticks = 0;
+		pit_set_periodic ();
+	} else {
+		/* Woken early by another interrupt.  Replay the whole
+		   ticks that went by and carry the rest of the current
+		   one into a one-shot that ends on its boundary. */
+		elapsed = idle_phase + (armed - remaining);
+		missed = elapsed / PIT_COUNT;
+		idle_phase = elapsed % PIT_COUNT;
+		if (idle_phase != 0) {
+			idle_oneshot_ticks = 1;
+			pit_set_oneshot (PIT_COUNT - idle_phase);
+		} else {
+			idle_oneshot_ticks = 0;
+			pit_set_periodic ();
+		}
+	}
+
+	skipped_ticks += missed;
+	while (missed-- > 0)
+		tick ();
+}
+
+/* Returns the number of timer ticks that were skipped by
+   tickless idle, i.e. accounted for without an interrupt. */
+int64_t
+timer_skipped_ticks (void) {
+	enum intr_level old_level = intr_disable ();
+	int64_t t = skipped_ticks;
+	intr_set_level (old_level);
+	return t;
+}
+
+/* Copies the timer interrupt statistics into STATS. */
+void
+timer_get_irq_stats (struct timer_irq_stats *stats) {
+	enum intr_level old_level = intr_disable ();
+	*stats = irq_stats;
+	intr_set_level (old_level);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) {
 	printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+	printf ("Timer wheel: %"PRIu64" events fired, %"PRIu64" cascaded\n",
+			irq_stats.expired, irq_stats.cascaded);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED) {
+	uint64_t start = rdtsc ();
+	uint64_t cycles;
+
+	tick ();
+
+	cycles = rdtsc () - start;
+	irq_stats.interrupts++;
+	irq_stats.cycles += cycles;
+	if (cycles > irq_stats.max_cycles)
+		irq_stats.max_cycles = cycles;
+}
+
+/* Advances the clock by one tick. */
+static void
+tick (void) {
+	seqlock_write_begin (&ticks_seq);
 	ticks++;
+	seqlock_write_end (&ticks_seq);
 	thread_tick ();
 
 	/* Alarm Clock */
-	//매 틱마다, 스레드가 sleep_list에서 깨어나야 하는지 확인하고 깨우기 함수 호출
-	thread_wakeup(ticks);
+	//매 틱마다 만료된 타이머 이벤트를 실행한다.
+	wheel_run ();
+}
+
+/* Programs PIT counter 0 to interrupt TIMER_FREQ times per
+   second. */
+static void
+pit_set_periodic (void) {
+	/* 8254 input frequency divided by TIMER_FREQ, rounded to
+	   nearest. */
+	uint16_t count = PIT_COUNT;
+
+	outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary.*/
+	outb (0x40, count & 0xff);	//PIT 주기 설정
+	outb (0x40, count >> 8);
+}
+
+/* Programs PIT counter 0 to interrupt once, COUNT input clocks
+   from now. */
+static void
+pit_set_oneshot (uint16_t count) {
+	outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary.*/
+	outb (0x40, count & 0xff);
+	outb (0x40, count >> 8);
+}
+
+/* Returns how many PIT input clocks went by since the last tick
+   boundary, with counter 0 in periodic mode. */
+static unsigned
+pit_periodic_phase (void) {
+	unsigned count;
+
+	outb (0x43, 0x00);    /* CW: counter 0, latch count. */
+	count = inb (0x40);
+	count |= inb (0x40) << 8;
+
+	/* Mode 2 counts down from PIT_COUNT to 1. */
+	return count >= 1 && count <= PIT_COUNT ? PIT_COUNT - count : 0;
+}
+
+/* Returns how many ticks from now the timer wheel next needs
+   attention, or MAX if that is further away.  Only level 0 is
+   searched, so a level 0 wrap-around, which may cascade events
+   down, counts as needing attention. */
+static int64_t
+wheel_next_due (int max) {
+	int64_t t;
+
+	ASSERT (spin_lock_held (&wheel_lock));
+
+	for (t = ticks + 1; t <= ticks + max; t++) {
+		int idx = t & (WHEEL0_SIZE - 1);
+		if (idx == 0 || !list_empty (&wheel0[idx]))
+			return t - ticks;
+	}
+	return max;
+}
+
+/* Puts pending EVENT into the wheel slot matching its expiry.
+   wheel_lock must be held. */
+static void
+wheel_insert (struct timer_event *event) {
+	int64_t expires = event->expires;
+	int64_t delta = expires - wheel_tick;
+	struct list *slot;
+	int level;
+
+	ASSERT (spin_lock_held (&wheel_lock));
+
+	if (delta < WHEEL_SPAN (0)) {
+		/* Already due events go to the next slot processed. */
+		if (delta < 0)
+			expires = wheel_tick;
+		slot = &wheel0[expires & (WHEEL0_SIZE - 1)];
+	} else {
+		for (level = 1; level < WHEEL_LEVELS - 1; level++)
+			if (delta < WHEEL_SPAN (level))
+				break;
+
+		/* Beyond the wheel's range: park it in the farthest slot,
+		   it will be re-inserted when that slot is cascaded. */
+		if (delta >= WHEEL_SPAN (level))
+			expires = wheel_tick + WHEEL_SPAN (level) - 1;
+
+		slot = &wheeln[level - 1][(expires >> (WHEEL0_BITS
+					+ WHEELN_BITS * (level - 1))) & (WHEELN_SIZE - 1)];
+	}
+	list_push_back (slot, &event->elem);
+}
+
+/* Re-inserts every event of slot IDX of wheel LEVEL (>= 1) into
+   the lower levels. */
+static void
+wheel_cascade (int level, int idx) {
+	struct list *slot = &wheeln[level - 1][idx];
+	struct list moving;
+
+	list_init (&moving);
+	while (!list_empty (slot))
+		list_push_back (&moving, list_pop_front (slot));
+	while (!list_empty (&moving)) {
+		struct timer_event *event =
+			list_entry (list_pop_front (&moving), struct timer_event, elem);
+		wheel_insert (event);
+		irq_stats.cascaded++;
+	}
+}
+
+/* Fires every event that expired up to and including `ticks'.
+   Runs in the timer interrupt. */
+static void
+wheel_run (void) {
+	ASSERT (intr_context ());
+
+	spin_lock (&wheel_lock);
+	while (wheel_tick <= ticks) {
+		int idx = wheel_tick & (WHEEL0_SIZE - 1);
+		struct list *slot = &wheel0[idx];
+
+		/* Level 0 wrapped: pull the next span down from above. */
+		if (idx == 0)
+			for (int level = 1; level < WHEEL_LEVELS; level++) {
+				int upper = (wheel_tick >> (WHEEL0_BITS
+							+ WHEELN_BITS * (level - 1))) & (WHEELN_SIZE - 1);
+				wheel_cascade (level, upper);
+				if (upper != 0)
+					break;
+			}
+
+		while (!list_empty (slot)) {
+			struct timer_event *event =
+				list_entry (list_pop_front (slot), struct timer_event, elem);
+			event->pending = false;
+			irq_stats.expired++;
+
+			/* The callback may add timer events of its own. */
+			spin_unlock (&wheel_lock);
+			event->func (event->aux);
+			spin_lock (&wheel_lock);
+		}
+		wheel_tick++;
+	}
+	spin_unlock (&wheel_lock);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -1,12 +1,38 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Function called when a timer event expires.  It runs in the
+   timer interrupt handler, so it must not sleep. */
+typedef void timer_event_func (void *aux);
+
+/* A one-shot kernel timer.  Kept in the timer wheel while
+   pending, so the storage must stay valid until it either fires
+   or is cancelled. */
+struct timer_event {
+	int64_t expires;            /* Absolute tick at which to fire. */
+	timer_event_func *func;     /* Callback. */
+	void *aux;                  /* Argument to FUNC. */
+	struct list_elem elem;      /* Element in a wheel slot. */
+	bool pending;               /* In the wheel? */
+};
+
+/* Timer interrupt statistics. */
+struct timer_irq_stats {
+	uint64_t interrupts;        /* Timer interrupts handled. */
+	uint64_t cycles;            /* TSC cycles spent in the handler. */
+	uint64_t max_cycles;        /* Most expensive single interrupt. */
+	uint64_t expired;           /* Events fired. */
+	uint64_t cascaded;          /* Events moved down a wheel level. */
+};
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -18,6 +44,15 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_event_init (struct timer_event *, timer_event_func *, void *aux);
+void timer_event_add (struct timer_event *, int64_t expires);
+bool timer_event_cancel (struct timer_event *);
+
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+int64_t timer_skipped_ticks (void);
+
+void timer_get_irq_stats (struct timer_irq_stats *);
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -36,6 +36,9 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* User-space synchronization. */
+	SYS_FUTEX,                  /* Wait on or wake a user address. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,28 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* Mutex built on futex().
+   0 = unlocked, 1 = locked, 2 = locked with possible waiters. */
+struct mutex {
+	int state;
+};
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable built on futex().  SEQ changes on every
+   signal, so a waiter that raced with a signal does not sleep. */
+struct condvar {
+	int seq;
+};
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
@@ -16,6 +16,10 @@ typedef int off_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Operations for futex(). */
+#define FUTEX_WAIT 0            /* Sleep if *uaddr still equals val. */
+#define FUTEX_WAKE 1            /* Wake up to val waiters on uaddr. */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -37,6 +41,7 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+int futex (int *uaddr, int op, int val);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
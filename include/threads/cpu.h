@@ -0,0 +1,55 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+
+/* Number of CPUs supported.  Pintos starts only the bootstrap
+   processor: there is no local APIC setup or application
+   processor start-up, so the per-CPU arrays have a single entry. */
+#define NCPU_MAX 1
+
+/* Number of PCIDs each CPU hands out to the address spaces it ran
+   last (see mmu.c). */
+#define CPU_PCID_CNT 6
+
+/* An address space that may have entries in a CPU's TLB. */
+struct pcid_slot {
+	uint64_t ctx_id;                    /* Context ID, or 0 if unused. */
+	uint64_t tlb_gen;                   /* Flush generation the TLB is at. */
+};
+
+/* Per-CPU state.
+
+   Everything that describes what one processor is doing, as
+   opposed to the system as a whole, lives here: its idle thread,
+   the time slice of the thread it runs, tick statistics, its TSS
+   and the address spaces cached in its TLB.  Each CPU also owns a
+   run queue (see thread.c). */
+struct cpu {
+	unsigned id;                        /* Index in cpus[]. */
+	struct thread *idle_thread;         /* Runs when nothing else can. */
+	unsigned thread_ticks;              /* # of timer ticks since last yield. */
+
+	/* Statistics. */
+	long long idle_ticks;               /* # of timer ticks spent idle. */
+	long long kernel_ticks;             /* # of timer ticks in kernel threads. */
+	long long user_ticks;               /* # of timer ticks in user programs. */
+
+	struct task_state *tss;             /* Task state segment. */
+
+	/* Address spaces tagged with PCID 1 + index, and the slot to
+	   recycle next. */
+	struct pcid_slot pcids[CPU_PCID_CNT];
+	unsigned pcid_next;
+};
+
+extern struct cpu cpus[NCPU_MAX];
+
+/* Returns the CPU executing the caller, which is always the
+   bootstrap processor. */
+static inline struct cpu *
+cpu_current (void) {
+	return &cpus[0];
+}
+
+#endif /* threads/cpu.h */
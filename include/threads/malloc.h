@@ -10,4 +10,12 @@ void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
 
+#ifdef MEMTRACK
+/* Charge each allocation to the file that makes it. */
+#include "threads/memtrack.h"
+#define malloc(SIZE) memtrack_malloc ((SIZE), __FILE__)
+#define calloc(A, B) memtrack_calloc ((A), (B), __FILE__)
+#define realloc(BLOCK, SIZE) memtrack_realloc ((BLOCK), (SIZE), __FILE__)
+#endif
+
 #endif /* threads/malloc.h */
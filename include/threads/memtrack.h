@@ -0,0 +1,47 @@
+#ifndef THREADS_MEMTRACK_H
+#define THREADS_MEMTRACK_H
+
+/* Kernel memory accounting and leak tracking.  See memtrack.c.
+
+   Built only with -DMEMTRACK (`make MEMTRACK=1').  malloc.h and
+   palloc.h then route the allocation functions through the
+   memtrack_*() wrappers below, which record the calling file so
+   that allocations can be charged to a subsystem. */
+#ifdef MEMTRACK
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/palloc.h"
+
+/* Subsystems that allocations are charged to, by the directory
+   of the file that made them. */
+enum memtrack_subsys {
+	MT_THREADS,                 /* threads/ */
+	MT_FILESYS,                 /* filesys/ */
+	MT_VM,                      /* vm/ */
+	MT_USERPROG,                /* userprog/ */
+	MT_OTHER,                   /* devices/, lib/, tests/... */
+	MT_SUBSYS_CNT
+};
+
+/* Allocation counters for one subsystem. */
+struct memtrack_counters {
+	long long allocs;           /* Allocations made. */
+	long long frees;            /* Allocations freed. */
+	size_t bytes;               /* Live malloc() bytes. */
+	size_t pages;               /* Live palloc() pages. */
+};
+
+void memtrack_init (void);
+void *memtrack_malloc (size_t, const char *file);
+void *memtrack_calloc (size_t, size_t, const char *file);
+void *memtrack_realloc (void *, size_t, const char *file);
+void *memtrack_palloc (enum palloc_flags, size_t page_cnt, const char *file);
+void memtrack_forget (const void *, bool pages);
+void memtrack_thread_exit (int tid);
+void memtrack_get_counters (enum memtrack_subsys, struct memtrack_counters *);
+size_t memtrack_held_by (int tid);
+void memtrack_print (int top_n);
+void memtrack_register_intr (void);
+#endif
+
+#endif /* threads/memtrack.h */
@@ -2,19 +2,44 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
+uint64_t *pml4e_walk_size (uint64_t *pml4, const uint64_t va,
+		uint64_t page_size, int create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+bool pml4_enable_pcid (void);
+void pml4_print_stats (void);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+long long pml4_split_cnt (void);
 void pml4_clear_page (uint64_t *pml4, void *upage);
+
+/* Maximum number of pages a TLB gather flushes one by one; above
+   that it flushes the whole address space. */
+#define TLB_GATHER_MAX 32
+
+/* Pages cleared from a page map whose TLB entries are flushed
+   together.  See mmu.c. */
+struct tlb_gather {
+	uint64_t *pml4;                 /* Page map level 4 being changed. */
+	size_t cnt;                     /* Number of pages cleared. */
+	void *pages[TLB_GATHER_MAX];    /* The first TLB_GATHER_MAX of them. */
+};
+
+void tlb_gather_init (struct tlb_gather *, uint64_t *pml4);
+void tlb_gather_add (struct tlb_gather *, void *upage);
+void tlb_gather_clear_page (struct tlb_gather *, void *upage);
+bool tlb_gather_clear_accessed (struct tlb_gather *, void *upage);
+void tlb_gather_finish (struct tlb_gather *);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
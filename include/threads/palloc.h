@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -11,13 +12,40 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* The page allocator hands out blocks of up to
+   2**PALLOC_MAX_ORDER pages from its buddy free lists. */
+#define PALLOC_MAX_ORDER 10
+#define PALLOC_ORDERS (PALLOC_MAX_ORDER + 1)
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* If true (default), the idle thread keeps a few free pages
+   zeroed ahead of time for PAL_ZERO requests.
+   Controlled by kernel command-line option "-no-prezero". */
+extern bool palloc_prezero;
+
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+bool palloc_extend (void *, size_t page_cnt, size_t extra_cnt);
+void palloc_share_page (void *);
+size_t palloc_page_refs (const void *);
+void palloc_set_owner (void *, size_t page_cnt, void *owner);
+void *palloc_get_owner (const void *);
+size_t palloc_free_blocks (enum palloc_flags, int order);
+void palloc_drain_caches (void);
+bool palloc_zero_idle (void);
+void palloc_print_stats (void);
+
+#ifdef MEMTRACK
+/* Charge each allocation to the file that makes it. */
+#include "threads/memtrack.h"
+#define palloc_get_page(FLAGS) memtrack_palloc ((FLAGS), 1, __FILE__)
+#define palloc_get_multiple(FLAGS, CNT) \
+	memtrack_palloc ((FLAGS), (CNT), __FILE__)
+#endif
 
 #endif /* threads/palloc.h */
@@ -41,5 +41,12 @@
 #define PTE_U 0x4                        /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20                       /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40                       /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80                      /* In a PDE or PDPE: 1=maps a large
+                                            page, 0=points to a table. */
+#define PTE_COW 0x200                    /* 1=copy-on-write (a PTE_AVL bit). */
+
+/* Sizes of the pages mapped by a PDE and by a PDPE with PTE_PS set. */
+#define LARGE_PGSIZE (1UL << PDXSHIFT)   /* 2 MB. */
+#define HUGE_PGSIZE (1UL << PDPESHIFT)   /* 1 GB. */
 
 #endif /* threads/pte.h */
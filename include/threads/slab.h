@@ -0,0 +1,24 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* A cache of equally sized objects.  See slab.c. */
+struct kmem_cache;
+
+/* Puts a newly allocated object OBJ into its initial state. */
+typedef void kmem_ctor (void *obj);
+
+void slab_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void *kmem_cache_zalloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+bool kmem_owns (const void *);
+void kmem_free (void *);
+size_t kmem_cache_pages (const struct kmem_cache *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -3,6 +3,10 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+struct thread;
 
 /* A counting semaphore. */
 struct semaphore {
@@ -20,13 +24,47 @@ void sema_self_test (void);
 struct lock {
 	struct thread *holder;      /* Thread holding lock (for debugging). */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	int max_priority;           /* Highest waiter priority, or -1. */
+	int held_idx;               /* Index in holder's held_locks heap,
+	                               LOCK_HELD_EXTRA or -1. */
+	struct list_elem held_elem; /* In holder's held_extra if LOCK_HELD_EXTRA. */
+#ifdef LOCK_PROFILE
+	struct lock_site *site;     /* Statistics for the lock_init() call site. */
+	uint64_t acquired_at;       /* TSC when the holder acquired it. */
+#endif
+};
+
+/* held_idx of a held lock that did not fit in its holder's heap. */
+#define LOCK_HELD_EXTRA (-2)
+
+void lock_init_named (struct lock *, const char *name);
+#ifdef LOCK_PROFILE
+/* Names every lock after the place that initialized it. */
+#define LOCK_SITE_STR(X) #X
+#define LOCK_SITE_XSTR(X) LOCK_SITE_STR (X)
+#define lock_init(LOCK) \
+	lock_init_named ((LOCK), __FILE__ ":" LOCK_SITE_XSTR (__LINE__))
+
+/* Statistics for all locks initialized at one call site. */
+struct lock_site {
+	const char *name;           /* "file:line" of lock_init(). */
+	uint64_t acquires;          /* # of acquisitions. */
+	uint64_t contended;         /* # of acquisitions that had to wait. */
+	int64_t wait_ticks;         /* Total timer ticks spent waiting. */
+	uint64_t max_hold;          /* Longest hold, in TSC cycles. */
+	int max_hold_tid;           /* Thread that held it that long. */
 };
 
+void lock_profile_print (int top_n);
+const struct lock_site *lock_profile_find (const char *name);
+#else
 void lock_init (struct lock *);
+#endif
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+int lock_held_max_priority (struct thread *);
 
 /* Condition variable. */
 struct condition {
@@ -38,6 +76,69 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+struct rwlock {
+	struct lock lock;           /* Held by the writer; taken briefly by readers. */
+	unsigned readers;           /* Number of readers holding the lock. */
+	bool writer_waiting;        /* Writer waiting for readers to drain? */
+	struct semaphore drained;   /* Upped when the last reader leaves. */
+};
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+bool rwlock_read_try_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+bool rwlock_write_try_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
+/* Spinlock.
+
+   Busy-waits instead of sleeping, so it may be used in interrupt
+   handlers and in the scheduler itself, but only for short
+   critical sections.  Interrupts must be off while a spinlock is
+   held, otherwise an interrupt handler on the same CPU could spin
+   forever on a lock its own CPU holds: use spin_lock_irqsave()
+   unless interrupts are known to be off already. */
+struct spinlock {
+	volatile unsigned locked;   /* Nonzero while held. */
+	const char *name;           /* Name (for debugging purposes). */
+	struct cpu *cpu;            /* CPU holding the lock (for debugging). */
+};
+
+void spin_lock_init (struct spinlock *, const char *name);
+void spin_lock (struct spinlock *);
+void spin_unlock (struct spinlock *);
+enum intr_level spin_lock_irqsave (struct spinlock *);
+void spin_unlock_irqrestore (struct spinlock *, enum intr_level);
+bool spin_lock_held (const struct spinlock *);
+
+/* Sequence lock.
+
+   For small values that are read far more often than written,
+   such as tick counters.  Readers never block writers: they take
+   a snapshot of the sequence number, read the value and retry if
+   a write happened in the meantime.  Writers are serialized by a
+   spinlock and so must run with interrupts off.
+
+      unsigned seq;
+      do {
+        seq = seqlock_read_begin (&sl);
+        value = shared_value;
+      } while (seqlock_read_retry (&sl, seq));
+*/
+struct seqlock {
+	volatile unsigned seq;      /* Odd while a write is in progress. */
+	struct spinlock lock;       /* Serializes writers. */
+};
+
+void seqlock_init (struct seqlock *);
+unsigned seqlock_read_begin (const struct seqlock *);
+bool seqlock_read_retry (const struct seqlock *, unsigned seq);
+void seqlock_write_begin (struct seqlock *);
+void seqlock_write_end (struct seqlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
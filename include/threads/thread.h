@@ -4,8 +4,10 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "devices/timer.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
@@ -29,8 +31,17 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, used by the MLFQS. */
+#define NICE_MIN -20                    /* Nicest to others. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 #define FDT_COUNT_LIMIT 128
 
+/* Number of held locks a thread keeps in its donation heap.  Any
+   more are kept in a list. */
+#define THREAD_HELD_LOCKS 16
+
 /* A kernel thread or user process.
  *
  * Each thread structure is stored in its own 4 kB page.  The
@@ -94,18 +105,39 @@ struct thread {
 	enum thread_status status;          /* Thread state. */
 	char name[16];                      /* Name (for debugging purposes). */
 	int priority;                       /* Priority. */
-
-	//local tick
-	int64_t wakeup_tick;
+	unsigned runq;                      /* Run queue holding us while ready. */
+
+	/* Multi-level feedback queue scheduler. */
+	int nice;                           /* Niceness. */
+	fixed_t recent_cpu;                 /* Recent CPU time received. */
+	unsigned mlfqs_epoch;               /* Decays applied to recent_cpu. */
+	struct list_elem mlfqs_elem;        /* Element in an mlfqs_stale list. */
+
+	/* Earliest-deadline-first reservation, in timer ticks.
+	   edf_period is 0 for threads in the priority class. */
+	int64_t edf_runtime;                /* Budget per period. */
+	int64_t edf_period;                 /* Length of a period. */
+	int64_t edf_deadline;               /* End of the current period. */
+	int64_t edf_budget;                 /* Budget left in this period. */
+	int64_t edf_job_deadline;           /* Deadline of the current job. */
+	bool edf_throttled;                 /* Out of budget? */
+	struct timer_event edf_timer;       /* Starts the next period. */
+	int edf_missed;                     /* # of jobs that missed their deadline. */
+	int64_t edf_max_lateness;           /* Worst lateness, in ticks. */
 
 	/* Shared between thread.c and synch.c. */
 	// 스레드를 이중 연결 목록 ready_list(실행 준비가 된 스레드 목록) 또는 세마포어를 기다리는 스레드 목록에 넣는데 사용되는 "목록 요소"
 	struct list_elem elem;     
 
-	int original_priority;
-	struct lock *wait_on_lock;
-	struct list donations;
-	struct list_elem d_elem;
+	/* Priority donation.  Each held lock knows the highest
+	   priority among its waiters; held_locks is a binary max-heap
+	   of the held locks ordered by that priority, so the best
+	   donation is always held_locks[0] or, rarely, in held_extra. */
+	int original_priority;              /* Priority without donations. */
+	struct lock *wait_on_lock;          /* Lock being waited for. */
+	struct lock *held_locks[THREAD_HELD_LOCKS];
+	int held_cnt;                       /* # of locks in held_locks. */
+	struct list held_extra;             /* Locks held beyond the heap. */
 
 	// system call
 	int last_create_fd;				//마지막 fd 갱신
@@ -129,6 +161,7 @@ struct thread {
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	uintptr_t user_rsp;                 /* User stack pointer in system calls. */
 #endif
 
 	/* Owned by thread.c. */
@@ -148,6 +181,11 @@ struct file_descriptor {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Upper bound, in percent of the CPU, on the total utilisation
+   of all EDF reservations.
+   Controlled by kernel command-line option "-edf-bound=PCT". */
+extern int thread_edf_bound;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -168,21 +206,22 @@ void thread_exit (void) NO_RETURN;
 void thread_yield (void);
 void thread_try_yield(void);
 
-void thread_sleep(int64_t);
-void thread_wakeup(int64_t);
-
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_refresh_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
+bool thread_edf_reserve (int64_t runtime, int64_t period);
+void thread_edf_cancel (void);
+void thread_edf_wait_period (void);
+
 void do_iret (struct intr_frame *tf);
 
 bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
-bool cmp_donor_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 
 
 
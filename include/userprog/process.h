@@ -9,6 +9,14 @@ int process_exec (void *f_name);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
+#ifndef VM
+/* Share pages copy-on-write on fork()?
+   Controlled by kernel command-line option "-no-cow". */
+extern bool process_cow;
+
+bool process_handle_cow (void *addr);
+void process_print_stats (void);
+#endif
 
 void argument_stack(char **argv, int argc, struct intr_frame *if_);
 struct thread *get_child_process(int pid);
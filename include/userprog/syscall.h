@@ -1,6 +1,10 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct file_descriptor;
+
 void syscall_init (void);
+struct file_descriptor *fd_alloc (void);
+void fd_free (struct file_descriptor *);
 
 #endif /* userprog/syscall.h */
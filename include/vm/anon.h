@@ -4,10 +4,23 @@
 struct page;
 enum vm_type;
 
+struct zcache_entry;
+
+/* An evicted anonymous page is either in the compressed swap cache
+   or in a swap slot. */
 struct anon_page {
+	size_t slot;                /* Swap slot holding the page, or
+	                               BITMAP_ERROR if it is not in one. */
+	struct zcache_entry *zentry;  /* Swap cache entry, or NULL. */
 };
 
+struct supplemental_page_table;
+
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+size_t anon_swap_neighbors (struct page *page, struct page *pages[],
+		size_t max);
+void anon_release_slots (struct supplemental_page_table *spt);
+void anon_print_stats (void);
 
 #endif
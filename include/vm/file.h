@@ -7,6 +7,7 @@ struct page;
 enum vm_type;
 
 struct file_page {
+	struct vm_range *range;     /* Mapping the page belongs to. */
 };
 
 void vm_file_init (void);
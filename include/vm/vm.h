@@ -1,7 +1,11 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include <hash.h>
+#include <list.h>
 #include <stdbool.h>
+#include "filesys/off_t.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type {
 	/* page not initialized */
@@ -46,6 +50,10 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	bool writable;         /* Mapped read/write? */
+	struct thread *owner;  /* Process whose address space holds the page. */
+	struct hash_elem spt_elem;  /* supplemental_page_table `pages' element. */
+	struct list_elem frame_elem; /* struct frame `pages' element. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -62,7 +70,11 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct page *page;     /* One of the pages mapping the frame. */
+	struct list pages;     /* All of them: more than one if they share
+	                          the frame copy-on-write after fork(). */
+	struct list_elem elem; /* Frame table element. */
+	unsigned pin_cnt;      /* Not evicted while nonzero. */
 };
 
 /* The function table for page operations.
@@ -81,10 +93,44 @@ struct page_operations {
 #define destroy(page) \
 	if ((page)->operations->destroy) (page)->operations->destroy (page)
 
+/* Maximum size of the user stack, in bytes. */
+#define VM_STACK_MAX (1 << 20)
+
+/* Kinds of address ranges. */
+enum vm_range_type {
+	RANGE_SEGMENT,         /* ELF segment. */
+	RANGE_STACK,           /* User stack, grown on demand. */
+	RANGE_MMAP             /* Memory-mapped file. */
+};
+
+/* A page-aligned range of user virtual addresses [START, END) in
+ * which the process may have pages.  The first READ_BYTES bytes
+ * are backed by FILE from OFFSET on, the rest is zero.
+ * Lazily loaded pages get their range as `aux', so that they find
+ * their contents without an allocation of their own. */
+struct vm_range {
+	struct list_elem elem; /* supplemental_page_table `ranges' element. */
+	uint8_t *start;        /* First address. */
+	uint8_t *end;          /* One past the last address. */
+	enum vm_range_type type;
+	bool writable;         /* May pages be written? */
+	struct file *file;     /* Backing file, reopened for the range, or null. */
+	off_t offset;          /* Offset of START in FILE. */
+	size_t read_bytes;     /* Number of bytes backed by FILE. */
+};
+
 /* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
+ * Pages are found in O(1) through a hash table keyed by address;
+ * the ranges that may hold pages are kept apart, sorted and
+ * disjoint, so that mmap(), munmap() and pointer checks work on a
+ * few intervals instead of on pages. */
 struct supplemental_page_table {
+	struct thread *owner;  /* Process whose memory this is. */
+	struct lock lock;      /* Serializes changes with eviction. */
+	size_t swap_next;      /* Next slot of the swap cluster (anon.c). */
+	size_t swap_left;      /* Number of slots left in the cluster. */
+	struct hash pages;     /* struct page, by va. */
+	struct list ranges;    /* struct vm_range, by start. */
 };
 
 #include "threads/thread.h"
@@ -96,8 +142,24 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 		void *va);
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
+struct vm_range *spt_find_range (struct supplemental_page_table *spt,
+		const void *addr);
+struct vm_range *spt_add_range (struct supplemental_page_table *spt,
+		void *start, size_t size, enum vm_range_type type, bool writable,
+		struct file *file, off_t offset, size_t read_bytes);
+void spt_remove_range (struct supplemental_page_table *spt,
+		struct vm_range *range);
+bool vm_prefault (const void *uaddr, size_t size, bool write);
+bool vm_pin (const void *uaddr, size_t size, bool write);
+void vm_unpin (const void *uaddr, size_t size);
+void vm_release_frame (struct page *page);
+
+/* Back aligned 2 MB regions of anonymous memory with large pages?
+   Controlled by kernel command-line option "-no-thp". */
+extern bool vm_thp;
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
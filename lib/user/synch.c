@@ -0,0 +1,85 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <synch.h>
+#include <syscall.h>
+
+/* Atomically replaces *P by NEW if it equals OLD, and returns
+   the value *P had before. */
+static int
+cmpxchg (int *p, int old, int new) {
+	__atomic_compare_exchange_n (p, &old, new, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+	return old;
+}
+
+/* Initializes M to unlocked. */
+void
+mutex_init (struct mutex *m) {
+	m->state = 0;
+}
+
+/* Acquires M, sleeping in the kernel while someone else holds it.
+   Uncontended acquisitions never enter the kernel. */
+void
+mutex_lock (struct mutex *m) {
+	int c = cmpxchg (&m->state, 0, 1);
+	if (c == 0)
+		return;
+
+	/* Mark the mutex contended before sleeping, so that the holder
+	   knows to wake us up when it unlocks. */
+	if (c != 2)
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex (&m->state, FUTEX_WAIT, 2);
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+/* Tries to acquire M without sleeping.  Returns true if
+   successful. */
+bool
+mutex_trylock (struct mutex *m) {
+	return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, waking up one waiter if there may be any. */
+void
+mutex_unlock (struct mutex *m) {
+	if (__atomic_fetch_sub (&m->state, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n (&m->state, 0, __ATOMIC_RELEASE);
+		futex (&m->state, FUTEX_WAKE, 1);
+	}
+}
+
+/* Initializes condition variable CV. */
+void
+condvar_init (struct condvar *cv) {
+	cv->seq = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  As with kernel condition variables, the caller
+   must recheck its condition on return. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m) {
+	int seq = __atomic_load_n (&cv->seq, __ATOMIC_ACQUIRE);
+
+	mutex_unlock (m);
+	futex (&cv->seq, FUTEX_WAIT, seq);
+	mutex_lock (m);
+}
+
+/* Wakes up one thread waiting on CV, if any. */
+void
+condvar_signal (struct condvar *cv) {
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex (&cv->seq, FUTEX_WAKE, 1);
+}
+
+/* Wakes up every thread waiting on CV. */
+void
+condvar_broadcast (struct condvar *cv) {
+	__atomic_fetch_add (&cv->seq, 1, __ATOMIC_RELEASE);
+	futex (&cv->seq, FUTEX_WAKE, INT32_MAX);
+}
@@ -184,6 +184,15 @@ dup2 (int oldfd, int newfd){
 	return syscall2 (SYS_DUP2, oldfd, newfd);
 }
 
+/* FUTEX_WAIT: sleeps until woken by FUTEX_WAKE on UADDR, unless
+   *UADDR no longer equals VAL, in which case it returns -1 at once.
+   FUTEX_WAKE: wakes up to VAL threads waiting on UADDR and returns
+   how many were woken. */
+int
+futex (int *uaddr, int op, int val) {
+	return syscall3 (SYS_FUTEX, uaddr, op, val);
+}
+
 void *
 mmap (void *addr, size_t length, int writable, int fd, off_t offset) {
 	return (void *) syscall5 (SYS_MMAP, addr, length, writable, fd, offset);
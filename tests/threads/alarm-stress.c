@@ -0,0 +1,111 @@
+/* Creates 2000 threads that sleep concurrently for durations
+   spread over several levels of the timer wheel, checks that no
+   thread wakes up early, and reports how much of each tick the
+   timer interrupt handler consumes. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define SLEEPER_CNT 2000
+#define ITER_CNT 3
+
+/* Longest sleep, in ticks.  Longer than the first wheel level so
+   that events get cascaded. */
+#define MAX_SLEEP 600
+
+/* Information about the test. */
+struct stress_test
+  {
+    struct semaphore done;      /* Upped by each sleeper on exit. */
+    int early;                  /* Number of early wake-ups. */
+  };
+
+/* Information about an individual sleeper. */
+struct stress_sleeper
+  {
+    struct stress_test *test;   /* Info shared between all threads. */
+    int id;                     /* Sleeper ID. */
+  };
+
+static thread_func sleeper;
+
+void
+test_alarm_stress (void)
+{
+  struct stress_test test;
+  struct stress_sleeper *sleepers;
+  struct timer_irq_stats before, after;
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, tsc_per_tick, interrupts, avg, max;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("Creating %d threads to sleep %d times each.", SLEEPER_CNT, ITER_CNT);
+
+  sleepers = malloc (sizeof *sleepers * SLEEPER_CNT);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+
+  sema_init (&test.done, 0);
+  test.early = 0;
+
+  timer_get_irq_stats (&before);
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      struct stress_sleeper *s = &sleepers[i];
+      s->test = &test;
+      s->id = i;
+      if (thread_create ("sleeper", PRI_DEFAULT, sleeper, s) == TID_ERROR)
+        fail ("out of memory creating thread %d", i);
+    }
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&test.done);
+  ticks = timer_elapsed (start_ticks);
+  tsc_per_tick = (rdtsc () - start_tsc) / (ticks > 0 ? ticks : 1);
+  timer_get_irq_stats (&after);
+
+  if (test.early != 0)
+    fail ("%d sleepers woke up early", test.early);
+
+  interrupts = after.interrupts - before.interrupts;
+  avg = (after.cycles - before.cycles) / (interrupts > 0 ? interrupts : 1);
+  max = after.max_cycles;
+  msg ("%d sleeps finished in %lld ticks, %llu events cascaded.",
+       SLEEPER_CNT * ITER_CNT, ticks, after.cascaded - before.cascaded);
+  msg ("Timer interrupt cost: avg %llu cycles (%llu.%03llu ticks), "
+       "max %llu cycles (%llu.%03llu ticks).",
+       avg, avg / tsc_per_tick, avg * 1000 / tsc_per_tick % 1000,
+       max, max / tsc_per_tick, max * 1000 / tsc_per_tick % 1000);
+
+  free (sleepers);
+  pass ();
+}
+
+/* Sleeper thread. */
+static void
+sleeper (void *s_)
+{
+  struct stress_sleeper *s = s_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      int64_t duration = (s->id * 37 + i * 101) % MAX_SLEEP + 1;
+      int64_t start = timer_ticks ();
+
+      timer_sleep (duration);
+      if (timer_elapsed (start) < duration)
+        s->test->early++;
+    }
+  sema_up (&s->test->done);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing timer interrupt cost"
+  unless grep (/^\(alarm-stress\) Timer interrupt cost: avg \d+ cycles/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(alarm-stress) PASS', @output);
+
+pass;
@@ -0,0 +1,82 @@
+/* Checks that the tick count keeps pace with real time while the
+   CPU idles tickless.  A few threads sleep for staggered lengths,
+   so that the idle thread arms one-shots of varying length and
+   phase, and the ticks that elapse are compared against the time
+   stamp counter, calibrated beforehand against busy ticks. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define SLEEPER_CNT 4
+#define ITER_CNT 20
+
+/* Ticks over which the time stamp counter is calibrated. */
+#define CALIBRATE_TICKS 50
+
+static thread_func sleeper;
+
+void
+test_alarm_tickless (void)
+{
+  struct semaphore done;
+  uint64_t start_tsc, tsc_per_tick, tsc;
+  int64_t start, ticks, skipped, expected;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Busy-wait, so that the timer keeps ticking periodically. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  start_tsc = rdtsc ();
+  start = timer_ticks ();
+  while (timer_elapsed (start) < CALIBRATE_TICKS)
+    continue;
+  tsc_per_tick = (rdtsc () - start_tsc) / CALIBRATE_TICKS;
+
+  msg ("Creating %d threads to sleep %d times each.", SLEEPER_CNT, ITER_CNT);
+  sema_init (&done, 0);
+  skipped = timer_skipped_ticks ();
+  start_tsc = rdtsc ();
+  start = timer_ticks ();
+  for (i = 0; i < SLEEPER_CNT; i++)
+    thread_create ("sleeper", PRI_DEFAULT, sleeper, &done);
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  ticks = timer_elapsed (start);
+  tsc = rdtsc () - start_tsc;
+  skipped = timer_skipped_ticks () - skipped;
+
+  if (skipped == 0)
+    fail ("no ticks were skipped while idle");
+
+  /* Allow for 5% of error in the calibration, plus one tick. */
+  expected = tsc / tsc_per_tick;
+  if (ticks < expected - expected / 20 - 1
+      || ticks > expected + expected / 20 + 1)
+    fail ("%lld ticks elapsed in %lld ticks of real time",
+          ticks, expected);
+  msg ("Tick count kept pace with real time.");
+  pass ();
+}
+
+/* Sleeper thread.  Sleeps ITER_CNT times for lengths that
+   depend on its ID. */
+static void
+sleeper (void *done_)
+{
+  struct semaphore *done = done_;
+  int id = thread_tid () % SLEEPER_CNT;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    timer_sleep ((id * 3 + i * 5) % 11 + 2);
+  sema_up (done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-tickless) begin
+(alarm-tickless) Creating 4 threads to sleep 20 times each.
+(alarm-tickless) Tick count kept pace with real time.
+(alarm-tickless) PASS
+(alarm-tickless) end
+EOF
+pass;
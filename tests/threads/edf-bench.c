@@ -0,0 +1,117 @@
+/* Runs three periodic tasks with EDF reservations against four
+   CPU-bound threads of the same static priority, and reports how
+   many deadlines each task missed and by how much.
+
+   Also checks that admission control rejects a reservation that
+   would overcommit the CPU. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define TASK_CNT 3
+#define HOG_CNT 4
+
+/* Length of the run, in ticks. */
+#define RUN_TICKS 400
+
+/* A periodic task. */
+struct edf_task
+  {
+    int64_t runtime;            /* Reserved ticks per period. */
+    int64_t period;             /* Period, in ticks. */
+    int64_t work;               /* Ticks of work per job. */
+    int jobs;                   /* Jobs completed. */
+    int missed;                 /* Deadlines missed. */
+    int64_t max_lateness;       /* Worst lateness, in ticks. */
+  };
+
+static struct edf_task tasks[TASK_CNT] =
+  {
+    {2, 10, 1, 0, 0, 0},
+    {3, 20, 2, 0, 0, 0},
+    {5, 50, 4, 0, 0, 0},
+  };
+
+static struct semaphore admitted;
+static struct semaphore done;
+static int64_t stop_tick;
+
+static thread_func task_thread;
+static thread_func hog_thread;
+
+void
+test_edf_bench (void)
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&admitted, 0);
+  sema_init (&done, 0);
+  stop_tick = timer_ticks () + RUN_TICKS;
+
+  for (i = 0; i < TASK_CNT; i++)
+    thread_create ("edf-task", PRI_DEFAULT, task_thread, &tasks[i]);
+  for (i = 0; i < HOG_CNT; i++)
+    thread_create ("hog", PRI_DEFAULT, hog_thread, NULL);
+
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&admitted);
+
+  /* The tasks reserve 45% of the CPU, so another 50% must not fit
+     under the default bound of 90%. */
+  if (thread_edf_reserve (1, 2))
+    fail ("reservation of 50%% admitted on top of 45%%");
+  msg ("Reservation of 50%% on top of 45%% rejected.");
+
+  for (i = 0; i < TASK_CNT + HOG_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < TASK_CNT; i++)
+    {
+      struct edf_task *task = &tasks[i];
+      msg ("Task %d (%lld/%lld ticks): %d jobs, %d deadlines missed, "
+           "worst lateness %lld ticks.", i, task->runtime, task->period,
+           task->jobs, task->missed, task->max_lateness);
+    }
+  pass ();
+}
+
+static void
+task_thread (void *task_)
+{
+  struct edf_task *task = task_;
+  struct thread *t = thread_current ();
+
+  if (!thread_edf_reserve (task->runtime, task->period))
+    fail ("reservation of %lld/%lld ticks rejected",
+          task->runtime, task->period);
+  sema_up (&admitted);
+
+  while (timer_ticks () < stop_tick)
+    {
+      int64_t start = timer_ticks ();
+      while (timer_elapsed (start) < task->work)
+        continue;
+      thread_edf_wait_period ();
+      task->jobs++;
+    }
+
+  task->missed = t->edf_missed;
+  task->max_lateness = t->edf_max_lateness;
+  thread_edf_cancel ();
+  sema_up (&done);
+}
+
+static void
+hog_thread (void *aux UNUSED)
+{
+  while (timer_ticks () < stop_tick)
+    continue;
+  sema_up (&done);
+}
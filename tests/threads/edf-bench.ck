@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "overcommitting reservation was not rejected"
+  unless grep ($_ eq '(edf-bench) Reservation of 50% on top of 45% rejected.',
+	       @output);
+foreach my $task (0...2) {
+    fail "missing result for task $task"
+      unless grep (/^\(edf-bench\) Task $task \(\d+\/\d+ ticks\): \d+ jobs, \d+ deadlines missed/,
+		   @output);
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(edf-bench) PASS', @output);
+
+pass;
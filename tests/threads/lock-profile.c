@@ -0,0 +1,62 @@
+/* The main thread acquires a lock and creates three
+   higher-priority threads that block acquiring it.  Once it
+   releases the lock, each of them acquires and releases it in
+   turn.  With lock profiling compiled in (`make LOCK_PROFILE=1'),
+   the lock's call site must then show four acquisitions, three of
+   them contended, and a longest hold by the main thread. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#ifdef LOCK_PROFILE
+#define WAITER_CNT 3
+
+static thread_func waiter_func;
+#endif
+
+void
+test_lock_profile (void) 
+{
+#ifdef LOCK_PROFILE
+  const struct lock_site *site;
+  struct lock lock;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init_named (&lock, "lock-profile");
+  lock_acquire (&lock);
+  for (i = 0; i < WAITER_CNT; i++)
+    thread_create ("waiter", PRI_DEFAULT + 1, waiter_func, &lock);
+  lock_release (&lock);
+
+  site = lock_profile_find ("lock-profile");
+  if (site == NULL)
+    fail ("no statistics for lock-profile");
+  msg ("%llu acquires, %llu contended.",
+       (unsigned long long) site->acquires,
+       (unsigned long long) site->contended);
+  if (site->max_hold == 0)
+    fail ("longest hold not recorded");
+  if (site->max_hold_tid != thread_tid ())
+    fail ("longest hold by thread %d, not the main thread",
+          site->max_hold_tid);
+#else
+  msg ("Lock profiling is not compiled in.");
+#endif
+}
+
+#ifdef LOCK_PROFILE
+static void
+waiter_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  lock_release (lock);
+}
+#endif
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(lock-profile) begin
+(lock-profile) 4 acquires, 3 contended.
+(lock-profile) end
+EOF
+(lock-profile) begin
+(lock-profile) Lock profiling is not compiled in.
+(lock-profile) end
+EOF
+pass;
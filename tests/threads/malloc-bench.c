@@ -0,0 +1,168 @@
+/* Allocates 1024 blocks with sizes drawn from a mix typical of
+   kernel requests, from small list nodes up to multi-page
+   buffers, and reports how much of the pages they take goes to
+   waste, for the whole mix and for the 1-8 kB requests that fall
+   between the power-of-2 classes and whole pages.  Then grows a
+   buffer with realloc() one page at a time and counts how often
+   it stays in place. */
+
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define OBJ_CNT 1024
+#define GROW_STEPS 16
+
+static void *objs[OBJ_CNT];
+
+/* Share of requests, in percent, and size range of each band. */
+static const struct band
+  {
+    int percent;
+    size_t min, max;
+  }
+bands[] =
+  {
+    { 45, 16, 128 },            /* List nodes, fds, small strings. */
+    { 25, 129, 512 },           /* Inodes, directory entries. */
+    { 12, 513, 1024 },          /* Path names, small buffers. */
+    { 10, 1025, 3072 },         /* Sector-sized and larger buffers. */
+    { 6, 3073, 8192 },          /* Page-sized buffers and tables. */
+    { 2, 8193, 16384 },         /* Multi-page buffers. */
+  };
+
+static unsigned long seed;
+
+/* Returns a pseudo-random number. */
+static unsigned
+next_random (void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 16;
+}
+
+/* Returns a random request size from the mix, or from bands 3 and
+   4 only if MID_ONLY. */
+static size_t
+random_size (bool mid_only)
+{
+  const struct band *b;
+  int pick = next_random () % 100;
+
+  if (mid_only)
+    b = &bands[3 + next_random () % 2];
+  else
+    for (b = bands; pick >= b->percent; b++)
+      pick -= b->percent;
+  return b->min + next_random () % (b->max - b->min + 1);
+}
+
+/* Returns the number of free kernel pages, with the page caches
+   drained so that all of them are counted. */
+static size_t
+free_pages (void)
+{
+  size_t cnt = 0;
+  int order;
+
+  palloc_drain_caches ();
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    cnt += palloc_free_blocks (0, order) << order;
+  return cnt;
+}
+
+/* Allocates OBJ_CNT blocks with sizes from random_size(MID_ONLY),
+   reports the waste, and frees them. */
+static void
+run (const char *name, bool mid_only)
+{
+  size_t before, pages, requested = 0, whole_pages = 0;
+  uint64_t start, cycles;
+  int i;
+
+  seed = 1;
+  before = free_pages ();
+  start = rdtsc ();
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      size_t size = random_size (mid_only);
+
+      objs[i] = malloc (size);
+      if (objs[i] == NULL)
+        fail ("out of memory");
+      requested += size;
+
+      /* What rounding everything above 1 kB, plus a header, up
+         to whole pages would take. */
+      if (size > 1024)
+        whole_pages += DIV_ROUND_UP (size + 32, PGSIZE);
+    }
+  cycles = rdtsc () - start;
+  pages = before - free_pages ();
+
+  start = rdtsc ();
+  for (i = 0; i < OBJ_CNT; i++)
+    free (objs[i]);
+  cycles += rdtsc () - start;
+
+  msg ("%s: %zu kB requested in %zu pages, %zu%% waste, "
+       "%llu cycles per malloc and free", name, requested / 1024, pages,
+       pages * PGSIZE > requested
+       ? (pages * PGSIZE - requested) * 100 / (pages * PGSIZE) : 0,
+       cycles / OBJ_CNT);
+  if (mid_only)
+    msg ("%s: whole pages would take %zu pages", name, whole_pages);
+}
+
+/* Grows a buffer from one page to GROW_STEPS pages with realloc(),
+   checking that its contents survive. */
+static void
+grow (void)
+{
+  size_t size = PGSIZE - 64;
+  uint8_t *buf = malloc (size);
+  int in_place = 0, i;
+  size_t j;
+
+  if (buf == NULL)
+    fail ("out of memory");
+  memset (buf, 0x5a, size);
+  for (i = 1; i < GROW_STEPS; i++)
+    {
+      uint8_t *new_buf = realloc (buf, size + PGSIZE);
+
+      if (new_buf == NULL)
+        fail ("out of memory");
+      if (new_buf == buf)
+        in_place++;
+      for (j = 0; j < size; j++)
+        if (new_buf[j] != 0x5a)
+          fail ("byte %zu lost by realloc", j);
+      buf = new_buf;
+      memset (buf + size, 0x5a, PGSIZE);
+      size += PGSIZE;
+    }
+  free (buf);
+  msg ("realloc: %d of %d page-sized grows in place", in_place,
+       GROW_STEPS - 1);
+}
+
+void
+test_malloc_bench (void)
+{
+  bool prezero = palloc_prezero;
+
+  /* Keep the idle thread from taking pages while we count. */
+  palloc_prezero = false;
+  run ("kernel mix", false);
+  run ("1-8 kB", true);
+  grow ();
+  palloc_prezero = prezero;
+  pass ();
+}
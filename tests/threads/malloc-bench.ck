@@ -0,0 +1,26 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $name ('kernel mix', '1-8 kB') {
+    fail "missing result for $name"
+      unless grep (/^\(malloc-bench\) $name: \d+ kB requested in \d+ pages, \d+% waste, \d+ cycles per malloc and free$/,
+		   @output);
+}
+fail "missing whole-page comparison"
+  unless grep (/^\(malloc-bench\) 1-8 kB: whole pages would take \d+ pages$/,
+	       @output);
+fail "missing realloc result"
+  unless grep (/^\(malloc-bench\) realloc: \d+ of \d+ page-sized grows in place$/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(malloc-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,88 @@
+/* With memory tracking compiled in (`make MEMTRACK=1'), checks
+   that a malloc() block and a run of pages allocated here are
+   charged to the right subsystem and uncharged when freed, and
+   that a block allocated by a thread that exits without freeing
+   it stays charged to that thread, where memtrack_print() reports
+   it as a leak. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+
+#ifdef MEMTRACK
+#define BLOCK_SIZE 100
+#define PAGE_CNT 3
+#define LEAK_SIZE 64
+
+static thread_func leaker_func;
+static void *leaked;
+
+/* Fails unless the counters of tests/ moved from BEFORE to AFTER
+   by ALLOCS allocations, FREES frees, BYTES live bytes and PAGES
+   live pages. */
+static void
+check_counters (const struct memtrack_counters *before,
+                const struct memtrack_counters *after,
+                int allocs, int frees, long bytes, long pages)
+{
+  if (after->allocs - before->allocs != allocs
+      || after->frees - before->frees != frees
+      || (long) (after->bytes - before->bytes) != bytes
+      || (long) (after->pages - before->pages) != pages)
+    fail ("counters moved by %lld allocs, %lld frees, %ld bytes, %ld pages",
+          after->allocs - before->allocs, after->frees - before->frees,
+          (long) (after->bytes - before->bytes),
+          (long) (after->pages - before->pages));
+}
+#endif
+
+void
+test_memtrack (void) 
+{
+#ifdef MEMTRACK
+  struct memtrack_counters before, after;
+  void *block, *pages;
+  tid_t tid;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("allocating %d bytes and %d pages", BLOCK_SIZE, PAGE_CNT);
+  memtrack_get_counters (MT_OTHER, &before);
+  block = malloc (BLOCK_SIZE);
+  pages = palloc_get_multiple (PAL_ASSERT, PAGE_CNT);
+  if (block == NULL)
+    fail ("malloc failed");
+  memtrack_get_counters (MT_OTHER, &after);
+  check_counters (&before, &after, 2, 0, BLOCK_SIZE, PAGE_CNT);
+
+  msg ("freeing them");
+  free (block);
+  palloc_free_multiple (pages, PAGE_CNT);
+  memtrack_get_counters (MT_OTHER, &after);
+  check_counters (&before, &after, 2, 2, 0, 0);
+
+  /* The leaker has higher priority, so it runs to its exit before
+     thread_create() returns. */
+  msg ("leaking %d bytes from a thread", LEAK_SIZE);
+  tid = thread_create ("leaker", PRI_DEFAULT + 1, leaker_func, NULL);
+  if (leaked == NULL)
+    fail ("leaker did not run");
+  msg ("%zu bytes held by the exited thread", memtrack_held_by (tid));
+  free (leaked);
+  msg ("%zu bytes held after freeing them", memtrack_held_by (tid));
+#else
+  msg ("Memory tracking is not compiled in.");
+#endif
+}
+
+#ifdef MEMTRACK
+static void
+leaker_func (void *aux UNUSED) 
+{
+  leaked = malloc (LEAK_SIZE);
+}
+#endif
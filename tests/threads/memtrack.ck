@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(memtrack) begin
+(memtrack) allocating 100 bytes and 3 pages
+(memtrack) freeing them
+(memtrack) leaking 64 bytes from a thread
+(memtrack) 64 bytes held by the exited thread
+(memtrack) 0 bytes held after freeing them
+(memtrack) end
+EOF
+(memtrack) begin
+(memtrack) Memory tracking is not compiled in.
+(memtrack) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Checks that recent_cpu keeps decaying while a thread sleeps
+   for longer than the scheduler remembers decay factors.
+
+   The main thread sets its nice value to 5, spins for 10
+   seconds to build up recent_cpu, then sleeps for 130 seconds.
+   While it sleeps, recent_cpu converges to nice * (2 * load_avg
+   + 1), the fixed point of the once-per-second decay, so that is
+   what it should be when the thread wakes up, give or take the
+   tick it may have run since. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define NICE 5
+
+void
+test_mlfqs_recent_sleep (void) 
+{
+  int64_t start_time;
+  int recent_cpu, load_avg, expected;
+
+  ASSERT (thread_mlfqs);
+
+  thread_set_nice (NICE);
+
+  msg ("Spinning for 10 seconds...");
+  start_time = timer_ticks ();
+  while (timer_elapsed (start_time) < 10 * TIMER_FREQ)
+    continue;
+  recent_cpu = thread_get_recent_cpu ();
+  if (recent_cpu < 500)
+    fail ("recent_cpu is only %d.%02d after spinning",
+          recent_cpu / 100, recent_cpu % 100);
+
+  msg ("Sleeping for 130 seconds...");
+  timer_sleep (130 * TIMER_FREQ);
+  recent_cpu = thread_get_recent_cpu ();
+  load_avg = thread_get_load_avg ();
+
+  expected = NICE * (2 * load_avg + 100);
+  if (recent_cpu < expected - 10 || recent_cpu > expected + 110)
+    fail ("recent_cpu is %d.%02d after sleeping, expected %d.%02d",
+          recent_cpu / 100, recent_cpu % 100,
+          expected / 100, expected % 100);
+  msg ("recent_cpu decayed while asleep.");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mlfqs-recent-sleep) begin
+(mlfqs-recent-sleep) Spinning for 10 seconds...
+(mlfqs-recent-sleep) Sleeping for 130 seconds...
+(mlfqs-recent-sleep) recent_cpu decayed while asleep.
+(mlfqs-recent-sleep) end
+EOF
+pass;
@@ -0,0 +1,102 @@
+/* Measures the page allocator on a random mix of multi-page
+   allocations and frees, and how fragmented it leaves the kernel
+   pool.  After everything is freed again, coalescing must have
+   restored exactly the free blocks the pool started with.  The
+   per-CPU page caches are drained before each look at the free
+   blocks, since single pages sit there instead, and the idle
+   thread is kept from taking pages out to pre-zero them. */
+
+#include <stdio.h>
+#include <random.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "intrinsic.h"
+
+#define SLOT_CNT 32
+#define OP_CNT 4000
+#define MAX_PAGES 16
+
+struct slot
+  {
+    void *pages;                /* Allocated pages, or null. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+static struct slot slots[SLOT_CNT];
+
+/* Reports the free blocks of the kernel pool under heading WHAT,
+   and stores their counts in COUNTS. */
+static void
+report (const char *what, size_t counts[PALLOC_ORDERS])
+{
+  size_t free_pages = 0, large_pages = 0;
+  int order, largest = -1;
+
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    {
+      counts[order] = palloc_free_blocks (0, order);
+      free_pages += counts[order] << order;
+      if (order >= 4)
+        large_pages += counts[order] << order;
+      if (counts[order] > 0)
+        largest = order;
+    }
+  msg ("%s: largest free block order %d, %zu%% of free pages in blocks "
+       "of 16 pages or more", what, largest,
+       free_pages > 0 ? large_pages * 100 / free_pages : 0);
+}
+
+void
+test_palloc_bench (void)
+{
+  size_t before[PALLOC_ORDERS], during[PALLOC_ORDERS], after[PALLOC_ORDERS];
+  bool prezero = palloc_prezero;
+  uint64_t start, cycles;
+  int allocs = 0, frees = 0;
+  int i, order;
+
+  palloc_prezero = false;
+  random_init (0);
+  palloc_drain_caches ();
+  report ("start", before);
+
+  start = rdtsc ();
+  for (i = 0; i < OP_CNT; i++)
+    {
+      struct slot *s = &slots[random_ulong () % SLOT_CNT];
+      if (s->pages != NULL)
+        {
+          palloc_free_multiple (s->pages, s->page_cnt);
+          s->pages = NULL;
+          frees++;
+        }
+      else
+        {
+          s->page_cnt = random_ulong () % MAX_PAGES + 1;
+          s->pages = palloc_get_multiple (PAL_ASSERT, s->page_cnt);
+          allocs++;
+        }
+    }
+  cycles = rdtsc () - start;
+  palloc_drain_caches ();
+  report ("loaded", during);
+
+  for (i = 0; i < SLOT_CNT; i++)
+    if (slots[i].pages != NULL)
+      {
+        palloc_free_multiple (slots[i].pages, slots[i].page_cnt);
+        slots[i].pages = NULL;
+      }
+  palloc_drain_caches ();
+  report ("end", after);
+
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    if (before[order] != after[order])
+      fail ("order %d: %zu free blocks before, %zu after",
+            order, before[order], after[order]);
+  palloc_prezero = prezero;
+  msg ("%d allocations and %d frees of 1 to %d pages, %llu cycles/op",
+       allocs, frees, MAX_PAGES, cycles / OP_CNT);
+  pass ();
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(palloc-bench\) \d+ allocations and \d+ frees of 1 to 16 pages, \d+ cycles\/op$/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(palloc-bench) PASS', @output);
+
+pass;
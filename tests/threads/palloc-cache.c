@@ -0,0 +1,77 @@
+/* Checks the per-CPU page caches in front of the page allocator.
+   A page that was just freed must be the next one handed out,
+   pages cycled through the caches must never be handed out twice
+   at once, and once the caches are drained every page must be
+   back in the pool, coalesced into the free blocks it started
+   from.  The idle thread is kept from taking pages out to
+   pre-zero them while the free blocks are compared. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+
+/* Enough pages to overflow a cache several times over. */
+#define PAGE_CNT 200
+
+static void *pages[PAGE_CNT];
+
+/* Stores the free block counts of the kernel pool in COUNTS. */
+static void
+count_free_blocks (size_t counts[PALLOC_ORDERS])
+{
+  int order;
+
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    counts[order] = palloc_free_blocks (0, order);
+}
+
+void
+test_palloc_cache (void)
+{
+  size_t before[PALLOC_ORDERS], after[PALLOC_ORDERS];
+  bool prezero = palloc_prezero;
+  void *page;
+  int i, round, order;
+
+  palloc_prezero = false;
+  palloc_drain_caches ();
+  count_free_blocks (before);
+
+  msg ("freeing and reallocating a page");
+  page = palloc_get_page (PAL_ASSERT);
+  palloc_free_page (page);
+  if (palloc_get_page (PAL_ASSERT) != page)
+    fail ("freed page %p was not the next one handed out", page);
+  palloc_free_page (page);
+
+  msg ("cycling %d pages through the caches", PAGE_CNT);
+  for (round = 0; round < 3; round++)
+    {
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          int *p = pages[i] = palloc_get_page (PAL_ASSERT);
+          p[0] = round;
+          p[1] = i;
+        }
+      for (i = 0; i < PAGE_CNT; i++)
+        {
+          int *p = pages[i];
+          if (p[0] != round || p[1] != i)
+            fail ("page %d of round %d at %p was handed out twice",
+                  i, round, pages[i]);
+        }
+      for (i = 0; i < PAGE_CNT; i++)
+        palloc_free_page (pages[round % 2 ? PAGE_CNT - 1 - i : i]);
+    }
+
+  msg ("draining the caches");
+  palloc_drain_caches ();
+  count_free_blocks (after);
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    if (before[order] != after[order])
+      fail ("order %d: %zu free blocks before, %zu after",
+            order, before[order], after[order]);
+  palloc_prezero = prezero;
+  pass ();
+}
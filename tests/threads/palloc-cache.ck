@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-cache) begin
+(palloc-cache) freeing and reallocating a page
+(palloc-cache) cycling 200 pages through the caches
+(palloc-cache) draining the caches
+(palloc-cache) PASS
+(palloc-cache) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Measures the latency of single-page PAL_ZERO allocations with
+   and without pages pre-zeroed by the idle thread, and checks
+   that every page handed out is actually zeroed. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define PAGE_CNT 32
+
+static void *pages[PAGE_CNT];
+
+/* Allocates PAGE_CNT zeroed pages, checks and frees them, and
+   returns the average allocation cost in cycles. */
+static uint64_t
+measure (void)
+{
+  uint64_t start, cycles;
+  size_t i, j;
+
+  start = rdtsc ();
+  for (i = 0; i < PAGE_CNT; i++)
+    pages[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  cycles = rdtsc () - start;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      const uint64_t *p = pages[i];
+      for (j = 0; j < PGSIZE / sizeof *p; j++)
+        if (p[j] != 0)
+          fail ("page %zu is not zeroed at byte %zu", i, j * sizeof *p);
+      palloc_free_page (pages[i]);
+    }
+  return cycles / PAGE_CNT;
+}
+
+void
+test_prezero_bench (void)
+{
+  bool prezero = palloc_prezero;
+  uint64_t with, without;
+
+  /* Give the idle thread time to fill the pre-zeroed pool. */
+  palloc_prezero = true;
+  timer_sleep (10);
+  with = measure ();
+
+  /* Throw away the pre-zeroed pages and stop making more. */
+  palloc_prezero = false;
+  palloc_drain_caches ();
+  timer_sleep (10);
+  without = measure ();
+
+  palloc_prezero = prezero;
+  msg ("PAL_ZERO page: %llu cycles pre-zeroed, %llu cycles zeroed on demand",
+       with, without);
+  pass ();
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(prezero-bench\) PAL_ZERO page: \d+ cycles pre-zeroed, \d+ cycles zeroed on demand$/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(prezero-bench) PASS', @output);
+
+pass;
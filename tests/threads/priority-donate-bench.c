@@ -0,0 +1,91 @@
+/* Measures the cost of lock acquisition under heavy priority
+   donation: 64 threads of different priorities contend for 8
+   locks, each taking a suffix of the locks in nested order, so
+   donations travel down chains of up to 8 locks.
+
+   The main thread starts out holding every lock, so all 64
+   threads pile up behind it before the measurement starts. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define THREAD_CNT 64
+#define LOCK_CNT 8
+#define ITER_CNT 50
+
+static struct lock locks[LOCK_CNT];
+static struct semaphore done;
+
+static thread_func contender;
+
+void
+test_priority_donate_bench (void)
+{
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int acquires = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      lock_init (&locks[i]);
+      lock_acquire (&locks[i]);
+    }
+
+  /* A contender created above our current priority runs at once,
+     blocks on one of our locks and donates to us.  The others
+     wait in the run queue until we release the locks. */
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int first = i % LOCK_CNT;
+      thread_create ("contender", PRI_DEFAULT + 1 + i % 16, contender,
+                     (void *) (intptr_t) first);
+      acquires += (LOCK_CNT - first) * ITER_CNT;
+    }
+  if (thread_get_priority () != PRI_DEFAULT + 16)
+    fail ("main thread should have priority %d, actual %d",
+          PRI_DEFAULT + 16, thread_get_priority ());
+
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = LOCK_CNT - 1; i >= 0; i--)
+    lock_release (&locks[i]);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  if (thread_get_priority () != PRI_DEFAULT)
+    fail ("main thread should have priority %d, actual %d",
+          PRI_DEFAULT, thread_get_priority ());
+  msg ("%d threads, %d nested locks: %d acquisitions in %lld ticks, "
+       "%llu cycles/acquisition", THREAD_CNT, LOCK_CNT, acquires, ticks,
+       cycles / acquires);
+  pass ();
+}
+
+static void
+contender (void *first_)
+{
+  int first = (intptr_t) first_;
+  int i, j;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      for (j = first; j < LOCK_CNT; j++)
+        lock_acquire (&locks[j]);
+      thread_yield ();
+      for (j = LOCK_CNT - 1; j >= first; j--)
+        lock_release (&locks[j]);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(priority-donate-bench\) 64 threads, 8 nested locks: \d+ acquisitions/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(priority-donate-bench) PASS', @output);
+
+pass;
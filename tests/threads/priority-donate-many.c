@@ -0,0 +1,76 @@
+/* The main thread acquires more locks than fit in its donation
+   heap, then creates two higher-priority threads that block on
+   two of the extra locks and thus donate their priorities to it.
+   Releasing the first locks moves the extra ones into the heap;
+   the donations must follow them until the main thread releases
+   the locks the donors wait for. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define LOCK_CNT (THREAD_HELD_LOCKS + 4)
+
+static thread_func donor_thread_func;
+
+void
+test_priority_donate_many (void) 
+{
+  static struct lock locks[LOCK_CNT];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      lock_init (&locks[i]);
+      lock_acquire (&locks[i]);
+    }
+  msg ("Main thread holds %d locks.", LOCK_CNT);
+
+  thread_create ("high", PRI_DEFAULT + 2, donor_thread_func,
+                 &locks[LOCK_CNT - 1]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+
+  thread_create ("mid", PRI_DEFAULT + 1, donor_thread_func,
+                 &locks[LOCK_CNT - 3]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+
+  lock_release (&locks[LOCK_CNT - 1]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+
+  for (i = 0; i < THREAD_HELD_LOCKS; i++)
+    lock_release (&locks[i]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 1, thread_get_priority ());
+
+  lock_release (&locks[LOCK_CNT - 3]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+
+  for (i = THREAD_HELD_LOCKS; i < LOCK_CNT - 1; i++)
+    if (i != LOCK_CNT - 3)
+      lock_release (&locks[i]);
+  msg ("Main thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+donor_thread_func (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  msg ("Thread %s acquired its lock.", thread_name ());
+  lock_release (lock);
+  msg ("Thread %s finished.", thread_name ());
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-many) begin
+(priority-donate-many) Main thread holds 20 locks.
+(priority-donate-many) Main thread should have priority 33.  Actual priority: 33.
+(priority-donate-many) Main thread should have priority 33.  Actual priority: 33.
+(priority-donate-many) Thread high acquired its lock.
+(priority-donate-many) Thread high finished.
+(priority-donate-many) Main thread should have priority 32.  Actual priority: 32.
+(priority-donate-many) Main thread should have priority 32.  Actual priority: 32.
+(priority-donate-many) Thread mid acquired its lock.
+(priority-donate-many) Thread mid finished.
+(priority-donate-many) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-many) Main thread should have priority 31.  Actual priority: 31.
+(priority-donate-many) end
+EOF
+pass;
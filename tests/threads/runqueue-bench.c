@@ -0,0 +1,87 @@
+/* Measures context-switch throughput of the scheduler with 16,
+   256 and 1024 threads in the run queue.
+
+   Every thread yields the CPU in a tight loop, so each yield is
+   one trip through next_thread_to_run().  The total number of
+   switches is held constant, so with an O(1) run queue the cost
+   per switch should not grow with the number of ready threads. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+/* Total number of yields performed at each thread count. */
+#define TOTAL_SWITCHES 32768
+
+struct bench_info
+  {
+    struct semaphore go;        /* Released once all threads exist. */
+    struct semaphore done;      /* Upped by each thread on exit. */
+    int yields;                 /* Yields per thread. */
+  };
+
+static thread_func yielder;
+static void run_bench (int thread_cnt);
+
+void
+test_runqueue_bench (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  run_bench (16);
+  run_bench (256);
+  run_bench (1024);
+  pass ();
+}
+
+static void
+run_bench (int thread_cnt)
+{
+  struct bench_info info;
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int i;
+
+  sema_init (&info.go, 0);
+  sema_init (&info.done, 0);
+  info.yields = TOTAL_SWITCHES / thread_cnt;
+
+  /* Run above the yielders while creating them, so that none of
+     them starts before all of them are in the run queue. */
+  thread_set_priority (PRI_DEFAULT + 1);
+  for (i = 0; i < thread_cnt; i++)
+    if (thread_create ("yielder", PRI_DEFAULT, yielder, &info) == TID_ERROR)
+      fail ("out of memory creating thread %d", i);
+  for (i = 0; i < thread_cnt; i++)
+    sema_up (&info.go);
+
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  thread_set_priority (PRI_DEFAULT);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&info.done);
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  msg ("%4d ready threads: %d switches in %lld ticks, %llu cycles/switch",
+       thread_cnt, info.yields * thread_cnt, ticks,
+       cycles / (uint64_t) (info.yields * thread_cnt));
+}
+
+static void
+yielder (void *info_)
+{
+  struct bench_info *info = info_;
+  int i;
+
+  sema_down (&info->go);
+  for (i = 0; i < info->yields; i++)
+    thread_yield ();
+  sema_up (&info->done);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $cnt (16, 256, 1024) {
+    fail "missing result for $cnt threads"
+      unless grep (/^\(runqueue-bench\)\s+$cnt ready threads: \d+ switches/,
+		   @output);
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(runqueue-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,109 @@
+/* Compares the throughput of a plain lock and a readers-writer
+   lock protecting a read-mostly table.  8 threads each perform
+   200 operations, 90% of them reads and 10% writes.  Every
+   operation yields the CPU once while it holds the lock, standing
+   in for a disk access made inside the critical section, so with
+   a plain lock the other threads pile up behind the holder while
+   with a readers-writer lock the readers can overlap. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
+
+#define THREAD_CNT 8
+#define ITER_CNT 200
+#define TABLE_SIZE 64
+
+/* Every WRITE_EVERY'th operation is a write. */
+#define WRITE_EVERY 10
+
+static struct lock lock;
+static struct rwlock rwlock;
+static bool use_rwlock;
+static int table[TABLE_SIZE];
+static struct semaphore done;
+
+static thread_func worker;
+static void run (const char *name, bool use_rwlock_);
+
+void
+test_rwlock_bench (void)
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&lock);
+  rwlock_init (&rwlock);
+  sema_init (&done, 0);
+
+  run ("lock", false);
+  run ("rwlock", true);
+  pass ();
+}
+
+/* Runs the workload once and reports its cost. */
+static void
+run (const char *name, bool use_rwlock_)
+{
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int ops = THREAD_CNT * ITER_CNT;
+  int i;
+
+  use_rwlock = use_rwlock_;
+
+  /* Create the workers above our priority so that they all run
+     to completion before we wake up again. */
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++)
+    thread_create ("worker", PRI_DEFAULT + 1, worker, (void *) (intptr_t) i);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  msg ("%s: %d ops (%d%% reads) in %lld ticks, %llu cycles/op",
+       name, ops, 100 - 100 / WRITE_EVERY, ticks, cycles / ops);
+}
+
+static void
+worker (void *id_)
+{
+  int id = (intptr_t) id_;
+  int i, j;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      bool write = (id + i) % WRITE_EVERY == 0;
+      int sum = 0;
+
+      if (!use_rwlock)
+        lock_acquire (&lock);
+      else if (write)
+        rwlock_write_acquire (&rwlock);
+      else
+        rwlock_read_acquire (&rwlock);
+
+      if (write)
+        table[(id + i) % TABLE_SIZE]++;
+      else
+        for (j = 0; j < TABLE_SIZE; j++)
+          sum += table[j];
+      thread_yield ();
+      if (!write && sum < 0)
+        fail ("table corrupted");
+
+      if (!use_rwlock)
+        lock_release (&lock);
+      else if (write)
+        rwlock_write_release (&rwlock);
+      else
+        rwlock_read_release (&rwlock);
+    }
+  sema_up (&done);
+}
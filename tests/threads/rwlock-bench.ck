@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $kind ('lock', 'rwlock') {
+    fail "missing $kind result"
+      unless grep (/^\(rwlock-bench\) $kind: \d+ ops \(90% reads\) in \d+ ticks, \d+ cycles\/op$/,
+		   @output);
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(rwlock-bench) PASS', @output);
+
+pass;
@@ -0,0 +1,81 @@
+/* The main thread and three higher-priority reader threads hold
+   a readers-writer lock for reading at the same time.  While
+   they do, a try to acquire it for writing must fail but a try
+   to acquire it for reading must succeed.  Once every reader has
+   left, the lock can be acquired for writing. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 3
+
+struct rwlock_test
+  {
+    struct rwlock rwlock;       /* Lock under test. */
+    struct semaphore go;        /* Lets the readers leave. */
+  };
+
+static thread_func reader_thread_func;
+
+void
+test_rwlock_readers (void) 
+{
+  struct rwlock_test test;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&test.rwlock);
+  sema_init (&test.go, 0);
+
+  rwlock_read_acquire (&test.rwlock);
+  for (i = 0; i < READER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 1, reader_thread_func, &test);
+    }
+  msg ("%d readers hold the lock.", test.rwlock.readers);
+
+  msg ("Write try-acquire %s.",
+       rwlock_write_try_acquire (&test.rwlock) ? "succeeded" : "failed");
+  if (rwlock_read_try_acquire (&test.rwlock))
+    {
+      msg ("Read try-acquire succeeded.");
+      rwlock_read_release (&test.rwlock);
+    }
+  else
+    msg ("Read try-acquire failed.");
+
+  rwlock_read_release (&test.rwlock);
+  for (i = 0; i < READER_CNT; i++)
+    sema_up (&test.go);
+
+  if (rwlock_write_try_acquire (&test.rwlock))
+    {
+      msg ("Write try-acquire succeeded.");
+      rwlock_write_release (&test.rwlock);
+    }
+  else
+    msg ("Write try-acquire failed.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+reader_thread_func (void *test_) 
+{
+  struct rwlock_test *test = test_;
+
+  rwlock_read_acquire (&test->rwlock);
+  msg ("%s: got the lock", thread_name ());
+  sema_down (&test->go);
+  rwlock_read_release (&test->rwlock);
+  msg ("%s: done", thread_name ());
+}
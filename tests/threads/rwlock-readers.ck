@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) reader 0: got the lock
+(rwlock-readers) reader 1: got the lock
+(rwlock-readers) reader 2: got the lock
+(rwlock-readers) 4 readers hold the lock.
+(rwlock-readers) Write try-acquire failed.
+(rwlock-readers) Read try-acquire succeeded.
+(rwlock-readers) reader 0: done
+(rwlock-readers) reader 1: done
+(rwlock-readers) reader 2: done
+(rwlock-readers) Write try-acquire succeeded.
+(rwlock-readers) This should be the last line before finishing this test.
+(rwlock-readers) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* The main thread holds a readers-writer lock for reading.  A
+   writer thread blocks waiting for it, then a higher-priority
+   reader arrives.  Because the lock prefers writers, the reader
+   must queue up behind the writer rather than join the main
+   thread, and it donates its priority to the writer while it
+   waits.  When the main thread releases the lock, the writer and
+   then the reader must get it, both ahead of the main thread. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+static thread_func reader_thread_func;
+
+void
+test_rwlock_writer (void) 
+{
+  struct rwlock rwlock;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rwlock);
+  rwlock_read_acquire (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rwlock);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rwlock);
+  msg ("Read try-acquire %s.",
+       rwlock_read_try_acquire (&rwlock) ? "succeeded" : "failed");
+  rwlock_read_release (&rwlock);
+  msg ("writer, reader must already have finished, in that order.");
+  msg ("This should be the last line before finishing this test.");
+}
+
+static void
+writer_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_write_acquire (rwlock);
+  msg ("writer: got the lock");
+  msg ("writer should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  rwlock_write_release (rwlock);
+  msg ("writer: done");
+}
+
+static void
+reader_thread_func (void *rwlock_) 
+{
+  struct rwlock *rwlock = rwlock_;
+
+  rwlock_read_acquire (rwlock);
+  msg ("reader: got the lock");
+  rwlock_read_release (rwlock);
+  msg ("reader: done");
+}
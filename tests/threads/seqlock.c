@@ -0,0 +1,44 @@
+/* Checks that a seqlock read must be retried if and only if a
+   write happened since it began, and that timer_ticks(), which
+   reads the tick counter under a seqlock, never goes backward
+   while the timer interrupt updates the counter. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+void
+test_seqlock (void) 
+{
+  struct seqlock sl;
+  enum intr_level old_level;
+  int64_t start, last;
+  unsigned seq;
+
+  seqlock_init (&sl);
+
+  seq = seqlock_read_begin (&sl);
+  msg ("Read with no write %s.",
+       seqlock_read_retry (&sl, seq) ? "must be retried" : "is valid");
+
+  seq = seqlock_read_begin (&sl);
+  old_level = intr_disable ();
+  seqlock_write_begin (&sl);
+  seqlock_write_end (&sl);
+  intr_set_level (old_level);
+  msg ("Read across a write %s.",
+       seqlock_read_retry (&sl, seq) ? "must be retried" : "is valid");
+
+  start = last = timer_ticks ();
+  while (last - start < 10)
+    {
+      int64_t now = timer_ticks ();
+      if (now < last)
+        fail ("timer_ticks() went from %lld back to %lld", last, now);
+      last = now;
+    }
+  msg ("timer_ticks() never went backward.");
+}
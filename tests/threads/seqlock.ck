@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(seqlock) begin
+(seqlock) Read with no write is valid.
+(seqlock) Read across a write must be retried.
+(seqlock) timer_ticks() never went backward.
+(seqlock) end
+EOF
+pass;
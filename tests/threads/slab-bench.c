@@ -0,0 +1,94 @@
+/* Compares a slab cache against malloc() for objects the size of
+   a file descriptor, a directory entry and an inode: how many
+   pages 512 live objects occupy, and what an allocation plus a
+   free costs. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "intrinsic.h"
+
+#define OBJ_CNT 512
+#define ITER_CNT 8
+
+static void *objs[OBJ_CNT];
+
+/* Returns the number of free kernel pages, with the page caches
+   drained so that all of them are counted. */
+static size_t
+free_pages (void)
+{
+  size_t cnt = 0;
+  int order;
+
+  palloc_drain_caches ();
+  for (order = 0; order < PALLOC_ORDERS; order++)
+    cnt += palloc_free_blocks (0, order) << order;
+  return cnt;
+}
+
+/* Allocates OBJ_CNT objects of SIZE bytes from cache C, or from
+   malloc() if C is null, and frees them again, ITER_CNT times.
+   Stores the pages the objects took in *PAGES and returns the
+   cycles per allocation and free. */
+static uint64_t
+run (struct kmem_cache *c, size_t size, size_t *pages)
+{
+  uint64_t start, cycles = 0;
+  size_t before;
+  int iter, i;
+
+  for (iter = 0; iter < ITER_CNT; iter++)
+    {
+      before = free_pages ();
+      start = rdtsc ();
+      for (i = 0; i < OBJ_CNT; i++)
+        {
+          objs[i] = c != NULL ? kmem_cache_alloc (c) : malloc (size);
+          if (objs[i] == NULL)
+            fail ("out of memory");
+        }
+      cycles += rdtsc () - start;
+      *pages = before - free_pages ();
+
+      start = rdtsc ();
+      for (i = 0; i < OBJ_CNT; i++)
+        {
+          if (c != NULL)
+            kmem_cache_free (c, objs[i]);
+          else
+            free (objs[i]);
+        }
+      cycles += rdtsc () - start;
+    }
+  return cycles / (ITER_CNT * OBJ_CNT);
+}
+
+void
+test_slab_bench (void)
+{
+  static const size_t sizes[] = { 32, 24, 552 };
+  static const char *names[] = { "fd-32", "dir-24", "inode-552" };
+  bool prezero = palloc_prezero;
+  size_t i;
+
+  /* Keep the idle thread from taking pages while we count. */
+  palloc_prezero = false;
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      struct kmem_cache *c = kmem_cache_create (names[i], sizes[i], NULL);
+      size_t malloc_pages, slab_pages;
+      uint64_t malloc_cycles, slab_cycles;
+
+      malloc_cycles = run (NULL, sizes[i], &malloc_pages);
+      slab_cycles = run (c, sizes[i], &slab_pages);
+      msg ("%zu-byte objects: malloc %zu pages, %llu cycles; "
+           "slab %zu pages, %llu cycles", sizes[i], malloc_pages,
+           malloc_cycles, slab_pages, slab_cycles);
+    }
+  palloc_prezero = prezero;
+  pass ();
+}
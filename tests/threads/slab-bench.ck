@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $size (32, 24, 552) {
+    fail "missing result for $size-byte objects"
+      unless grep (/^\(slab-bench\) $size-byte objects: malloc \d+ pages, \d+ cycles; slab \d+ pages, \d+ cycles$/,
+		   @output);
+}
+fail "missing PASS in output"
+  unless grep ($_ eq '(slab-bench) PASS', @output);
+
+pass;
@@ -25,10 +25,28 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-many", test_priority_donate_many},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"runqueue-bench", test_runqueue_bench},
+    {"alarm-stress", test_alarm_stress},
+    {"alarm-tickless", test_alarm_tickless},
+    {"edf-bench", test_edf_bench},
+    {"priority-donate-bench", test_priority_donate_bench},
+    {"rwlock-readers", test_rwlock_readers},
+    {"rwlock-writer", test_rwlock_writer},
+    {"seqlock", test_seqlock},
+    {"lock-profile", test_lock_profile},
+    {"palloc-cache", test_palloc_cache},
+    {"memtrack", test_memtrack},
+    {"rwlock-bench", test_rwlock_bench},
+    {"palloc-bench", test_palloc_bench},
+    {"prezero-bench", test_prezero_bench},
+    {"slab-bench", test_slab_bench},
+    {"malloc-bench", test_malloc_bench},
+    {"tlb-bench", test_tlb_bench},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +56,7 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"mlfqs-recent-sleep", test_mlfqs_recent_sleep},
   };
 
 static const char *test_name;
@@ -19,10 +19,28 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_many;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_runqueue_bench;
+extern test_func test_alarm_stress;
+extern test_func test_alarm_tickless;
+extern test_func test_edf_bench;
+extern test_func test_priority_donate_bench;
+extern test_func test_rwlock_readers;
+extern test_func test_rwlock_writer;
+extern test_func test_seqlock;
+extern test_func test_lock_profile;
+extern test_func test_palloc_cache;
+extern test_func test_memtrack;
+extern test_func test_rwlock_bench;
+extern test_func test_palloc_bench;
+extern test_func test_prezero_bench;
+extern test_func test_slab_bench;
+extern test_func test_malloc_bench;
+extern test_func test_tlb_bench;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +50,7 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_recent_sleep;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,53 @@
+/* Reads one word from each page of up to 32 MB of kernel memory,
+   in a scattered order, through the kernel's direct map, and
+   reports the cycles per read.  With 4 kB pages nearly every read
+   misses the TLB; with the 2 MB pages the direct map normally
+   uses, few do.  Compare against a run with -no-large-pages. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+#define BLOCK_PAGES 1024        /* Pages per allocation, 4 MB. */
+#define BLOCK_CNT 8
+#define PASS_CNT 8
+
+static uint8_t *blocks[BLOCK_CNT];
+
+void
+test_tlb_bench (void)
+{
+  size_t block_cnt, page_cnt, i, idx;
+  uint64_t start, cycles;
+  volatile uint64_t sum = 0;
+  int iter;
+
+  for (block_cnt = 0; block_cnt < BLOCK_CNT; block_cnt++)
+    {
+      blocks[block_cnt] = palloc_get_multiple (0, BLOCK_PAGES);
+      if (blocks[block_cnt] == NULL)
+        break;
+    }
+  if (block_cnt == 0)
+    fail ("out of memory");
+  page_cnt = block_cnt * BLOCK_PAGES;
+
+  /* Step through the pages with a stride coprime to their number,
+     so that consecutive reads land far apart. */
+  start = rdtsc ();
+  for (iter = 0; iter < PASS_CNT; iter++)
+    for (i = 0, idx = iter; i < page_cnt; i++, idx = (idx + 4099) % page_cnt)
+      sum += *(uint64_t *) (blocks[idx / BLOCK_PAGES]
+                            + idx % BLOCK_PAGES * PGSIZE);
+  cycles = rdtsc () - start;
+
+  for (i = 0; i < block_cnt; i++)
+    palloc_free_multiple (blocks[i], BLOCK_PAGES);
+
+  msg ("%zu pages read %d times: %llu cycles per read",
+       page_cnt, PASS_CNT, cycles / (page_cnt * PASS_CNT));
+  pass ();
+}
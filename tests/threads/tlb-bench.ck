@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(tlb-bench\) \d+ pages read \d+ times: \d+ cycles per read$/,
+	       @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(tlb-bench) PASS', @output);
+
+pass;
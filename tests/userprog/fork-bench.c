@@ -0,0 +1,71 @@
+/* Measures the latency of fork() for a parent with a 512 kB data
+   working set, first with children that exit at once, as before
+   an exec(), then with children that rewrite all of it.  The
+   "Fork:" line printed at power off tells how many pages were
+   shared and copied; run with the kernel's -no-cow option to
+   compare against copying everything up front. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 16
+#define PAGE_CNT 128
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+static uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Forks ROUNDS children that write WRITE_CNT pages of BUF each and
+   exit, and returns the average number of cycles fork() took. */
+static uint64_t
+fork_children (int write_cnt)
+{
+  uint64_t cycles = 0;
+  int i, j;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      uint64_t start = read_tsc ();
+      int pid = fork ("child");
+
+      if (pid == 0)
+        {
+          for (j = 0; j < write_cnt; j++)
+            buf[j * PAGE_SIZE] = 2;
+          exit (0);
+        }
+      cycles += read_tsc () - start;
+      if (wait (pid) != 0)
+        fail ("child %d did not exit cleanly", pid);
+    }
+
+  for (j = 0; j < PAGE_CNT; j++)
+    if (buf[j * PAGE_SIZE] != 1)
+      fail ("child write leaked into the parent at page %d", j);
+  return cycles / ROUNDS;
+}
+
+void
+test_main (void)
+{
+  uint64_t cycles;
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = 1;
+
+  cycles = fork_children (0);
+  msg ("fork, exit: %llu cycles per fork", (unsigned long long) cycles);
+  cycles = fork_children (PAGE_CNT);
+  msg ("fork, write %d pages, exit: %llu cycles per fork", PAGE_CNT,
+       (unsigned long long) cycles);
+}
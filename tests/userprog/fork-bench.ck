@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(fork-bench\) fork, exit: \d+ cycles per fork$/, @output);
+fail "missing result"
+  unless grep (/^\(fork-bench\) fork, write 128 pages, exit: \d+ cycles per fork$/,
+	       @output);
+fail "child did not exit cleanly"
+  unless grep ($_ eq 'child: exit(0)', @output) == 32;
+fail "parent did not exit cleanly"
+  unless grep ($_ eq 'fork-bench: exit(0)', @output);
+
+pass;
@@ -0,0 +1,69 @@
+/* Ping-pongs between a parent and short-lived children: each
+   round forks a child that exits at once and waits for it, which
+   switches address spaces twice.  Reports the cost of a round
+   trip and of touching the parent's working set right after one,
+   which is where keeping the TLB across switches pays off.  Run
+   with and without the kernel's -no-pcid option to compare. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 32
+#define PAGE_CNT 64
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+static uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+/* Reads one byte of each page of BUF. */
+static int
+touch (void)
+{
+  int sum = 0;
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    sum += *(volatile char *) &buf[i * PAGE_SIZE];
+  return sum;
+}
+
+void
+test_main (void)
+{
+  uint64_t switch_cycles = 0, touch_cycles = 0;
+  int i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = 1;
+  touch ();
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      uint64_t start = read_tsc ();
+      int pid = fork ("child");
+
+      if (pid == 0)
+        exit (0);
+      if (wait (pid) != 0)
+        fail ("child %d did not exit cleanly", pid);
+      switch_cycles += read_tsc () - start;
+
+      start = read_tsc ();
+      if (touch () != PAGE_CNT)
+        fail ("working set changed");
+      touch_cycles += read_tsc () - start;
+    }
+
+  msg ("%d round trips: %llu cycles each, %llu cycles to touch %d pages after",
+       ROUNDS, (unsigned long long) (switch_cycles / ROUNDS),
+       (unsigned long long) (touch_cycles / ROUNDS), PAGE_CNT);
+}
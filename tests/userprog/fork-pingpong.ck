@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(fork-pingpong\) 32 round trips: \d+ cycles each, \d+ cycles to touch 64 pages after$/,
+	       @output);
+fail "child did not exit cleanly"
+  unless grep ($_ eq 'child: exit(0)', @output) == 32;
+fail "missing end"
+  unless grep ($_ eq '(fork-pingpong) end', @output);
+fail "parent did not exit cleanly"
+  unless grep ($_ eq 'fork-pingpong: exit(0)', @output);
+
+pass;
@@ -0,0 +1,94 @@
+/* Exercises futex() and the mutex and condition variable built on
+   it.  A FUTEX_WAIT whose value is stale must return at once, a
+   FUTEX_WAKE with no waiters must wake nobody, a FUTEX_WAIT on a
+   page shared with a forked child must sleep until the child
+   wakes it, and each forked child must be able to use the mutex
+   it inherited from its parent. */
+
+#include <syscall.h>
+#include <synch.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+#define ITER_CNT 1000
+#define PAGE_SIZE 4096
+
+/* A word alone on its page.  Neither process writes the page
+   after fork(), so it stays shared and both find the same futex. */
+static int shared_word[PAGE_SIZE / sizeof (int)]
+  __attribute__ ((aligned (PAGE_SIZE))) = { 1 };
+
+static struct mutex mutex;
+static struct condvar condvar;
+static int counter;
+
+/* Increments the counter ITER_CNT times under the mutex. */
+static void
+count (void)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      mutex_lock (&mutex);
+      counter++;
+      condvar_signal (&condvar);
+      mutex_unlock (&mutex);
+    }
+}
+
+void
+test_main (void) 
+{
+  int word = 42;
+  int pid, val, ret;
+  int i;
+
+  msg ("stale FUTEX_WAIT returns %d", futex (&word, FUTEX_WAIT, 43));
+  msg ("FUTEX_WAKE without waiters wakes %d",
+       futex (&word, FUTEX_WAKE, 1));
+  msg ("misaligned futex returns %d",
+       futex ((int *) ((char *) &word + 1), FUTEX_WAKE, 1));
+
+  /* Read the word so that its page is in memory, and shared
+     rather than loaded separately by each process. */
+  val = shared_word[0];
+  pid = fork ("child");
+  if (pid == 0)
+    {
+      int woken;
+
+      /* Keep waking until the parent is asleep on the word. */
+      while ((woken = futex (shared_word, FUTEX_WAKE, 1)) == 0)
+        continue;
+      exit (woken);
+    }
+  ret = futex (shared_word, FUTEX_WAIT, val);
+  val = wait (pid);
+  msg ("FUTEX_WAIT on a shared word returns %d", ret);
+  msg ("Parent: waker exit status is %d", val);
+
+  mutex_init (&mutex);
+  condvar_init (&condvar);
+  mutex_lock (&mutex);
+  if (mutex_trylock (&mutex))
+    fail ("mutex_trylock succeeded on a held mutex");
+  mutex_unlock (&mutex);
+  if (!mutex_trylock (&mutex))
+    fail ("mutex_trylock failed on a free mutex");
+  mutex_unlock (&mutex);
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid = fork ("child");
+      if (pid == 0)
+        {
+          count ();
+          exit (counter / ITER_CNT);
+        }
+      count ();
+      msg ("Parent: child exit status is %d", wait (pid));
+    }
+  msg ("Parent: counter is %d", counter);
+}
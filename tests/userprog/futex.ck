@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(futex) begin
+(futex) stale FUTEX_WAIT returns -1
+(futex) FUTEX_WAKE without waiters wakes 0
+(futex) misaligned futex returns -1
+child: exit(1)
+(futex) FUTEX_WAIT on a shared word returns 0
+(futex) Parent: waker exit status is 1
+child: exit(1)
+(futex) Parent: child exit status is 1
+child: exit(2)
+(futex) Parent: child exit status is 2
+child: exit(3)
+(futex) Parent: child exit status is 3
+child: exit(4)
+(futex) Parent: child exit status is 4
+(futex) Parent: counter is 4000
+(futex) end
+futex: exit(0)
+EOF
+pass;
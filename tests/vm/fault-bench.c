@@ -0,0 +1,58 @@
+/* Measures the cost of first-touch page faults over a 64 MB
+   zero-filled region: the first half is touched in address
+   order, the second half in a scattered order that defeats any
+   locality in the supplemental page table.  The test runs with
+   the kernel's -no-thp option, so that every 4 kB page takes its
+   own fault instead of one fault mapping a whole 2 MB page. */
+
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (64 * 1024 * 1024)
+#define HALF_PAGES (SIZE / 2 / PAGE_SIZE)
+
+/* Odd, hence coprime to HALF_PAGES, so that stepping by it visits
+   every page once. */
+#define STRIDE 4099
+
+static char buf[SIZE];
+
+static uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  char *seq = buf;
+  char *rnd = buf + SIZE / 2;
+  uint64_t start, cycles;
+  size_t i, page;
+
+  start = read_tsc ();
+  for (i = 0; i < HALF_PAGES; i++)
+    seq[i * PAGE_SIZE] = 1;
+  cycles = read_tsc () - start;
+  msg ("sequential: %llu cycles per page",
+       (unsigned long long) (cycles / HALF_PAGES));
+
+  start = read_tsc ();
+  for (i = 0, page = 0; i < HALF_PAGES; i++)
+    {
+      rnd[page * PAGE_SIZE] = 1;
+      page = (page + STRIDE) % HALF_PAGES;
+    }
+  cycles = read_tsc () - start;
+  msg ("random: %llu cycles per page",
+       (unsigned long long) (cycles / HALF_PAGES));
+
+  for (i = 0; i < SIZE / PAGE_SIZE; i++)
+    if (buf[i * PAGE_SIZE] != 1 || buf[i * PAGE_SIZE + 1] != 0)
+      fail ("page %zu has wrong contents", i);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing result"
+  unless grep (/^\(fault-bench\) sequential: \d+ cycles per page$/, @output);
+fail "missing result"
+  unless grep (/^\(fault-bench\) random: \d+ cycles per page$/, @output);
+fail "process did not exit cleanly"
+  unless grep ($_ eq 'fault-bench: exit(0)', @output);
+
+pass;
@@ -0,0 +1,88 @@
+/* Touches a zero-filled buffer big enough to span whole aligned
+   2 MB regions, which the kernel may back with large pages, and
+   checks that it reads as zeros and then holds what was written
+   to each of its pages.  Then forks, and checks that the child's
+   writes to every third page stay out of the parent's copy, which
+   requires splitting the large mappings for copy-on-write. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define CHUNK_SIZE (6 * 1024 * 1024)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char buf[CHUNK_SIZE];
+
+/* Returns the word that page I of buf holds after being written
+   with seed SEED. */
+static unsigned
+pattern (size_t i, unsigned seed)
+{
+  return i * 2654435761u + seed;
+}
+
+/* Returns true if every page of buf holds the pattern for SEED,
+   or for CHILD_SEED if it is one of every third page and
+   CHILD_SEED is nonzero. */
+static bool
+check_buf (unsigned seed, unsigned child_seed)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      unsigned *p = (unsigned *) (buf + i * PAGE_SIZE);
+      unsigned want = pattern (i, child_seed != 0 && i % 3 == 0
+                                  ? child_seed : seed);
+
+      if (p[0] != want || p[PAGE_SIZE / sizeof *p - 1] != want)
+        return false;
+    }
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  for (i = 0; i < CHUNK_SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu is %d, not zero", i, buf[i]);
+  msg ("buffer reads as zeros");
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      unsigned *p = (unsigned *) (buf + i * PAGE_SIZE);
+      p[0] = p[PAGE_SIZE / sizeof *p - 1] = pattern (i, 1);
+    }
+  if (!check_buf (1, 0))
+    fail ("buffer does not hold what was written");
+  msg ("buffer holds what was written");
+
+  child = fork ("child");
+  if (child < 0)
+    fail ("fork");
+  if (child == 0)
+    {
+      if (!check_buf (1, 0))
+        exit (1);
+      for (i = 0; i < PAGE_COUNT; i += 3)
+        {
+          unsigned *p = (unsigned *) (buf + i * PAGE_SIZE);
+          p[0] = p[PAGE_SIZE / sizeof *p - 1] = pattern (i, 2);
+        }
+      exit (check_buf (1, 2) ? 0 : 2);
+    }
+  if (wait (child) != 0)
+    fail ("child saw inconsistent data");
+  msg ("child saw consistent data");
+
+  if (!check_buf (1, 0))
+    fail ("parent's data changed");
+  msg ("parent's data unchanged");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-huge) begin
+(page-huge) buffer reads as zeros
+(page-huge) buffer holds what was written
+(page-huge) child saw consistent data
+(page-huge) parent's data unchanged
+(page-huge) end
+EOF
+pass;
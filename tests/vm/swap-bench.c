@@ -0,0 +1,54 @@
+/* Measures the cost of paging through an 8 MB anonymous region,
+   about twice the user memory of the 8 MB machine it runs on:
+   one pass writes every page, then two passes read them back in
+   address order, so that nearly every access swaps a page in and
+   another out.  The "Swap:" and "VM:" lines printed at power off
+   tell how many pages went each way, how many were written next
+   to each other and how many were read ahead. */
+
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SIZE (8 * 1024 * 1024)
+#define PAGES (SIZE / PAGE_SIZE)
+#define READ_PASSES 2
+
+static char buf[SIZE];
+
+static uint64_t
+read_tsc (void)
+{
+  uint32_t lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+}
+
+void
+test_main (void)
+{
+  uint64_t start, cycles;
+  size_t i;
+  int pass;
+
+  start = read_tsc ();
+  for (i = 0; i < PAGES; i++)
+    {
+      buf[i * PAGE_SIZE] = i;
+      buf[i * PAGE_SIZE + PAGE_SIZE - 1] = i >> 8;
+    }
+  cycles = read_tsc () - start;
+  msg ("write: %llu cycles per page",
+       (unsigned long long) (cycles / PAGES));
+
+  start = read_tsc ();
+  for (pass = 0; pass < READ_PASSES; pass++)
+    for (i = 0; i < PAGES; i++)
+      if (buf[i * PAGE_SIZE] != (char) i
+          || buf[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) (i >> 8))
+        fail ("page %zu has wrong contents", i);
+  cycles = read_tsc () - start;
+  msg ("read: %llu cycles per page",
+       (unsigned long long) (cycles / (READ_PASSES * PAGES)));
+}
@@ -0,0 +1,96 @@
+/* Forks twice with more anonymous memory than fits in RAM, so
+   that frames the processes share copy-on-write have to be
+   evicted, then checks that every process still sees the data
+   it should, both before and after it writes to half the pages.
+   For this test, Pintos memory size is 10 MB. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define CHUNK_SIZE (6 * ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+#define CHILD_CNT 2
+
+static char big_chunk[CHUNK_SIZE];
+
+/* Writes the first bytes of page I of big_chunk, derived from I
+   and SEED. */
+static void
+fill_page (size_t i, int seed)
+{
+  char *mem = big_chunk + i * PAGE_SIZE;
+  size_t j;
+
+  for (j = 0; j < 16; j++)
+    mem[j] = (char) (i * 31 + j * 7 + seed);
+}
+
+/* Returns true if page I of big_chunk holds what fill_page (I,
+   SEED) wrote. */
+static bool
+check_page (size_t i, int seed)
+{
+  const char *mem = big_chunk + i * PAGE_SIZE;
+  size_t j;
+
+  for (j = 0; j < 16; j++)
+    if (mem[j] != (char) (i * 31 + j * 7 + seed))
+      return false;
+  return true;
+}
+
+/* Checks all of big_chunk: pages that are even-numbered or odd-
+   numbered, depending on PARITY, as written with seed SEED and
+   the others with seed 0. */
+static bool
+check_chunk (size_t parity, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (!check_page (i, i % 2 == parity ? seed : 0))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t child[CHILD_CNT];
+  size_t i;
+  int c;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    fill_page (i, 0);
+
+  for (c = 0; c < CHILD_CNT; c++)
+    {
+      child[c] = fork ("child");
+      if (child[c] < 0)
+        fail ("fork");
+      if (child[c] == 0)
+        {
+          /* Children only check, since their output would
+             interleave. */
+          if (!check_chunk (0, 0))
+            exit (1);
+          for (i = c % 2; i < PAGE_COUNT; i += 2)
+            fill_page (i, c + 1);
+          exit (check_chunk (c % 2, c + 1) ? 0 : 2);
+        }
+    }
+
+  for (c = 0; c < CHILD_CNT; c++)
+    if (wait (child[c]) != 0)
+      fail ("child %d saw inconsistent data", c);
+  msg ("children saw consistent data");
+
+  if (!check_chunk (0, 0))
+    fail ("parent's data changed");
+  msg ("parent's data unchanged");
+}
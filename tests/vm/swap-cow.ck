@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-cow) begin
+(swap-cow) children saw consistent data
+(swap-cow) parent's data unchanged
+(swap-cow) end
+EOF
+pass;
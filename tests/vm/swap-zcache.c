@@ -0,0 +1,82 @@
+/* Writes more anonymous memory than fits in RAM, in pages that
+   compress well, pages that are zero but for one word, and pages
+   that do not compress at all, then reads all of it back twice,
+   front to back and back to front.  Evicted pages that compress
+   come back from the compressed swap cache, the others and those
+   spilled from the cache from the swap disk; every byte of every
+   page must survive the round trip.
+   For this test, Pintos memory size is 10 MB. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define CHUNK_SIZE (12 * ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char big_chunk[CHUNK_SIZE];
+
+/* Returns byte J of page I. */
+static char
+page_byte (size_t i, size_t j)
+{
+  switch (i % 4)
+    {
+    case 0:
+    case 1:
+      /* Runs of letters, which compress well. */
+      return 'a' + (j / 16 + i) % 26;
+    case 2:
+      /* Zero but for the page number in the middle. */
+      return j == PAGE_SIZE / 2 ? (char) (i | 1) : 0;
+    default:
+      {
+        /* Pseudo-random bytes, which do not compress. */
+        uint32_t x = (i * PAGE_SIZE + j) * 2654435761u;
+        x ^= x >> 15;
+        x *= 2246822519u;
+        return x >> 24;
+      }
+    }
+}
+
+/* Returns true if page I of big_chunk holds what it should. */
+static bool
+check_page (size_t i)
+{
+  const char *mem = big_chunk + i * PAGE_SIZE;
+  size_t j;
+
+  for (j = 0; j < PAGE_SIZE; j++)
+    if (mem[j] != page_byte (i, j))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  size_t i, j;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      char *mem = big_chunk + i * PAGE_SIZE;
+      for (j = 0; j < PAGE_SIZE; j++)
+        mem[j] = page_byte (i, j);
+    }
+  msg ("wrote %d pages", PAGE_COUNT);
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (!check_page (i))
+      fail ("page %zu is corrupted on the first pass", i);
+  msg ("read them back front to back");
+
+  for (i = PAGE_COUNT; i-- > 0; )
+    if (!check_page (i))
+      fail ("page %zu is corrupted on the second pass", i);
+  msg ("read them back back to front");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-zcache) begin
+(swap-zcache) wrote 3072 pages
+(swap-zcache) read them back front to back
+(swap-zcache) read them back back to front
+(swap-zcache) end
+EOF
+pass;
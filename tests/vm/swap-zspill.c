@@ -0,0 +1,73 @@
+/* Overflows the compressed swap cache.  Every page is half
+   pseudo-random bytes and half runs of letters, so it compresses,
+   but only to a little over 2 kB.  The 12 MB written do not fit
+   in the 10 MB of RAM, so at least 512 of these pages are
+   evicted, which takes more than 1 MB of cache entries, twice the
+   cache's 512 kB budget: older entries must be spilled to the
+   swap disk while newer pages are stored.  Every byte of every
+   page must survive.
+   For this test, Pintos memory size is 10 MB. */
+
+#include <string.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define CHUNK_SIZE (12 * ONE_MB)
+#define PAGE_COUNT (CHUNK_SIZE / PAGE_SIZE)
+
+static char big_chunk[CHUNK_SIZE];
+
+/* Returns byte J of page I. */
+static char
+page_byte (size_t i, size_t j)
+{
+  if (j < PAGE_SIZE / 2)
+    {
+      uint32_t x = (i * PAGE_SIZE + j) * 2654435761u;
+      x ^= x >> 15;
+      x *= 2246822519u;
+      return x >> 24;
+    }
+  return 'a' + (j / 32 + i) % 26;
+}
+
+/* Returns true if page I of big_chunk holds what it should. */
+static bool
+check_page (size_t i)
+{
+  const char *mem = big_chunk + i * PAGE_SIZE;
+  size_t j;
+
+  for (j = 0; j < PAGE_SIZE; j++)
+    if (mem[j] != page_byte (i, j))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  size_t i, j;
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    {
+      char *mem = big_chunk + i * PAGE_SIZE;
+      for (j = 0; j < PAGE_SIZE; j++)
+        mem[j] = page_byte (i, j);
+    }
+  msg ("wrote %d pages", PAGE_COUNT);
+
+  for (i = 0; i < PAGE_COUNT; i++)
+    if (!check_page (i))
+      fail ("page %zu is corrupted on the first pass", i);
+  msg ("read them back front to back");
+
+  for (i = PAGE_COUNT; i-- > 0; )
+    if (!check_page (i))
+      fail ("page %zu is corrupted on the second pass", i);
+  msg ("read them back back to front");
+}
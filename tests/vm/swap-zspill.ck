@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-zspill) begin
+(swap-zspill) wrote 3072 pages
+(swap-zspill) read them back front to back
+(swap-zspill) read them back back to front
+(swap-zspill) end
+EOF
+pass;
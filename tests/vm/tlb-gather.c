@@ -0,0 +1,82 @@
+/* Checks that pages cleared or write-protected in bulk, with one
+   TLB flush for all of them, cannot be reached through stale TLB
+   entries.  The test touches every page of a buffer, so that their
+   entries are cached, then forks and writes to all of them: the
+   child must still see the old data.  Then it maps a file of more
+   pages than are flushed one by one, reads every page, unmaps it,
+   and must be killed when it reads the region again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BUF_PAGES 64
+#define MAP_PAGES 40
+#define ACTUAL ((void *) 0x10000000)
+
+static char buf[BUF_PAGES * PAGE_SIZE];
+
+/* Writes the first word of each of the CNT pages at P, derived
+   from the page number and SEED. */
+static void
+fill (char *p, size_t cnt, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    *(int *) (p + i * PAGE_SIZE) = i * 7 + seed;
+}
+
+/* Returns true if the CNT pages at P hold what fill (P, CNT, SEED)
+   wrote. */
+static bool
+check (const char *p, size_t cnt, int seed)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (*(const int *) (p + i * PAGE_SIZE) != (int) (i * 7 + seed))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  int handle;
+  pid_t child;
+
+  fill (buf, BUF_PAGES, 1);
+  if (!check (buf, BUF_PAGES, 1))
+    fail ("buffer does not hold what was written");
+
+  child = fork ("child");
+  if (child < 0)
+    fail ("fork");
+  if (child == 0)
+    exit (check (buf, BUF_PAGES, 1) ? 0 : 1);
+  fill (buf, BUF_PAGES, 2);
+  if (wait (child) != 0)
+    fail ("child saw the parent's writes");
+  if (!check (buf, BUF_PAGES, 2))
+    fail ("parent lost its writes");
+  msg ("parent's writes after fork stayed private");
+
+  CHECK (create ("tlb.dat", 0), "create \"tlb.dat\"");
+  CHECK ((handle = open ("tlb.dat")) > 1, "open \"tlb.dat\"");
+  fill (buf, MAP_PAGES, 3);
+  if (write (handle, buf, MAP_PAGES * PAGE_SIZE) != MAP_PAGES * PAGE_SIZE)
+    fail ("write \"tlb.dat\"");
+  CHECK (mmap (ACTUAL, MAP_PAGES * PAGE_SIZE, 0, handle, 0) != MAP_FAILED,
+         "mmap \"tlb.dat\"");
+  if (!check (ACTUAL, MAP_PAGES, 3))
+    fail ("mapped file does not hold what was written");
+  msg ("mapped file is readable");
+
+  munmap (ACTUAL);
+
+  fail ("unmapped memory is readable (%d)",
+        *(int *) (ACTUAL + (MAP_PAGES - 1) * PAGE_SIZE));
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(tlb-gather) begin
+child: exit(0)
+(tlb-gather) parent's writes after fork stayed private
+(tlb-gather) create "tlb.dat"
+(tlb-gather) open "tlb.dat"
+(tlb-gather) mmap "tlb.dat"
+(tlb-gather) mapped file is readable
+tlb-gather: exit(-1)
+EOF
+pass;
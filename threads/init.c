@@ -1,6 +1,7 @@
 #include "threads/init.h"
 #include <console.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <random.h>
 #include <stddef.h>
@@ -17,10 +18,13 @@
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
+#include "threads/memtrack.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -38,6 +42,9 @@
 #include "filesys/fsutil.h"
 #endif
 
+/* CR0 bit that applies write protection to kernel accesses. */
+#define CR0_WP 0x00010000
+
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
 
@@ -51,6 +58,18 @@ bool power_off_when_done;
 
 bool thread_tests;
 
+/* -no-large-pages: Map memory with 2 MB pages? */
+static bool large_pages = true;
+
+/* -no-pcid: Tag TLB entries with process-context identifiers? */
+static bool pcids = true;
+
+#ifdef LOCK_PROFILE
+/* lockstat: Number of most contended lock sites to print at
+   power off. */
+static int lockstat_top_n;
+#endif
+
 static void bss_init (void);
 static void paging_init (uint64_t mem_end);
 
@@ -83,8 +102,12 @@ main (void) {
 	console_init ();
 
 	/* Initialize memory system. */
+#ifdef MEMTRACK
+	memtrack_init ();
+#endif
 	mem_end = palloc_init ();
 	malloc_init ();
+	slab_init ();
 	paging_init (mem_end);
 
 #ifdef USERPROG
@@ -100,6 +123,9 @@ main (void) {
 #ifdef USERPROG
 	exception_init ();
 	syscall_init ();
+#endif
+#ifdef MEMTRACK
+	memtrack_register_intr ();
 #endif
 	/* Start thread scheduler and enable interrupts. */
 	thread_start ();
@@ -140,31 +166,71 @@ bss_init (void) {
 	memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* Returns true if the SIZE-byte page at physical address PA can
+ * be mapped with a single entry: both PA and its kernel virtual
+ * address are aligned, it lies below MEM_END and it holds no
+ * kernel text, which stays read-only at 4 kB granularity. */
+static bool
+can_map_page (uint64_t pa, uint64_t size, uint64_t mem_end) {
+	extern char start, _end_kernel_text;
+
+	return pa % size == 0 && (uint64_t) ptov (pa) % size == 0
+		&& pa + size <= mem_end
+		&& (pa + size <= vtop (&start) || pa >= vtop (&_end_kernel_text));
+}
+
 /* Populates the page table with the kernel virtual mapping,
  * and then sets up the CPU to use the new page directory.
- * Points base_pml4 to the pml4 it creates. */
+ * Points base_pml4 to the pml4 it creates.
+ *
+ * Memory is mapped with 2 MB pages, so that the direct map needs
+ * only a few page table pages and TLB entries.  4 kB pages remain
+ * around the kernel text and at the unaligned end of memory, and
+ * everywhere with -no-large-pages.  1 GB pages are not used:
+ * LOADER_KERN_BASE is 64 MB past a 1 GB boundary, so no physical
+ * address and its kernel virtual address are both 1 GB aligned. */
 static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
 	int perm;
+	size_t counts[2] = { 0, 0 };        /* 4 kB, 2 MB pages. */
+	uint64_t start_tsc = rdtsc ();
+	uint64_t pa, size;
 	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
 	//   [LOADER_KERN_BASE ~ LOADER_KERN_BASE + mem_end].
-	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
+	for (pa = 0; pa < mem_end; pa += size) {
 		uint64_t va = (uint64_t) ptov(pa);
 
 		perm = PTE_P | PTE_W;
-		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
-			perm &= ~PTE_W;
-
-		if ((pte = pml4e_walk (pml4, va, 1)) != NULL)
+		if (large_pages && can_map_page (pa, LARGE_PGSIZE, mem_end)) {
+			size = LARGE_PGSIZE;
+			perm |= PTE_PS;
+			counts[1]++;
+		} else {
+			size = PGSIZE;
+			if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
+				perm &= ~PTE_W;
+			counts[0]++;
+		}
+
+		if ((pte = pml4e_walk_size (pml4, va, size, 1)) != NULL)
 			*pte = pa | perm;
 	}
 
 	// reload cr3
 	pml4_activate(0);
+	/* Make read-only pages read-only for the kernel too, so that
+	   its writes to copy-on-write user pages fault. */
+	lcr0 (rcr0 () | CR0_WP);
+	if (pcids)
+		pml4_enable_pcid ();
+
+	printf ("Paging: %'"PRIu64" kB mapped with %zu 2 MB and %zu 4 kB "
+			"pages in %'"PRIu64" cycles\n", mem_end / 1024, counts[1],
+			counts[0], rdtsc () - start_tsc);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -221,11 +287,27 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-edf-bound"))
+			thread_edf_bound = atoi (value);
+		else if (!strcmp (name, "-no-prezero"))
+			palloc_prezero = false;
+		else if (!strcmp (name, "-no-large-pages"))
+			large_pages = false;
+		else if (!strcmp (name, "-no-pcid"))
+			pcids = false;
+#ifdef VM
+		else if (!strcmp (name, "-no-thp"))
+			vm_thp = false;
+#endif
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#ifndef VM
+		else if (!strcmp (name, "-no-cow"))
+			process_cow = false;
+#endif
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -252,6 +334,24 @@ run_task (char **argv) {
 	printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef LOCK_PROFILE
+/* Arranges for the ARGV[1] most contended lock sites to be
+   printed at power off. */
+static void
+lockstat (char **argv) {
+	lockstat_top_n = atoi (argv[1]);
+}
+#endif
+
+#ifdef MEMTRACK
+/* Prints kernel memory use and the ARGV[1] call sites holding
+   the most memory. */
+static void
+memstat (char **argv) {
+	memtrack_print (atoi (argv[1]));
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -266,6 +366,12 @@ run_actions (char **argv) {
 	/* Table of supported actions. */
 	static const struct action actions[] = {
 		{"run", 2, run_task},
+#ifdef LOCK_PROFILE
+		{"lockstat", 2, lockstat},
+#endif
+#ifdef MEMTRACK
+		{"memstat", 2, memstat},
+#endif
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},
 		{"cat", 2, fsutil_cat},
@@ -312,6 +418,12 @@ usage (void) {
 #else
 			"  run TEST           Run TEST.\n"
 #endif
+#ifdef LOCK_PROFILE
+			"  lockstat N         Print the N most contended locks at power off.\n"
+#endif
+#ifdef MEMTRACK
+			"  memstat N          Print memory use and the N biggest allocators.\n"
+#endif
 #ifdef FILESYS
 			"  ls                 List files in the root directory.\n"
 			"  cat FILE           Print FILE to the console.\n"
@@ -326,8 +438,18 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -edf-bound=PCT     Admit EDF reservations up to PCT%% of the CPU.\n"
+			"  -no-prezero        Do not pre-zero pages in the idle thread.\n"
+			"  -no-large-pages    Map all memory with 4 kB pages.\n"
+			"  -no-pcid           Flush the TLB on every address space switch.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#ifndef VM
+			"  -no-cow            Copy all memory on fork().\n"
+#endif
+#endif
+#ifdef VM
+			"  -no-thp            Do not map user memory with 2 MB pages.\n"
 #endif
 			);
 	power_off ();
@@ -343,6 +465,10 @@ power_off (void) {
 #endif
 
 	print_stats ();
+#ifdef LOCK_PROFILE
+	if (lockstat_top_n > 0)
+		lock_profile_print (lockstat_top_n);
+#endif
 
 	printf ("Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -354,6 +480,9 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	palloc_print_stats ();
+	kmem_cache_print_stats ();
+	pml4_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
@@ -361,5 +490,11 @@ print_stats (void) {
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
+#ifndef VM
+	process_print_stats ();
+#endif
+#endif
+#ifdef VM
+	vm_print_stats ();
 #endif
 }
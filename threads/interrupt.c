@@ -344,6 +344,9 @@ intr_handler (struct intr_frame *frame) {
 
 		in_external_intr = true;
 		yield_on_return = false;
+
+		/* Catch up on ticks missed while the CPU idled tickless. */
+		timer_idle_exit ();
 	}
 
 	/* Invoke the interrupt's handler. */
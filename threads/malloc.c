@@ -6,38 +6,57 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/palloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
+#ifdef MEMTRACK
+/* Define the real functions; memtrack.c wraps them.  The pages of
+   our arenas are not tracked, the blocks in them are. */
+#undef malloc
+#undef calloc
+#undef realloc
+#undef palloc_get_page
+#undef palloc_get_multiple
+#endif
+
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
+   The size of each request, in bytes, is rounded up to the next
+   size class and assigned to the "descriptor" that manages blocks
+   of that size.  The classes are the powers of 2 up to 1 kB, then
+   1.5, 2, 3 and 6 kB.  The descriptor keeps a list of free blocks.
+   If the free list is nonempty, one of its blocks is used to
    satisfy the request.
 
-   Otherwise, a new page of memory, called an "arena", is
-   obtained from the page allocator (if none is available,
-   malloc() returns a null pointer).  The new arena is divided
-   into blocks, all of which are added to the descriptor's free
-   list.  Then we return one of the new blocks.
+   Otherwise, a new run of pages, called an "arena", is obtained
+   from the page allocator (if none is available, malloc() returns
+   a null pointer).  Small classes use single-page arenas; larger
+   ones use arenas of up to ARENA_MAX_PAGES pages, so that the
+   space left over after the last block stays under an eighth of
+   the arena.  The new arena is divided into blocks, all of which
+   are added to the descriptor's free list.  Then we return one of
+   the new blocks.  Blocks of a multi-page arena may straddle page
+   boundaries, so every page of an arena is tagged with
+   palloc_set_owner() to find the arena header from any block.
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Requests bigger than the largest class, and those that whole
+   pages would hold with less waste, are "big blocks": we allocate
+   contiguous pages with the page allocator and stick the page
+   count at the beginning of the block's arena header.  realloc()
+   grows a big block in place when the pages right after it are
+   free, and shrinks one by giving back its tail pages. */
 
 /* Descriptor. */
 struct desc {
 	size_t block_size;          /* Size of each element in bytes. */
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
+	size_t arena_pages;         /* Number of pages in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
 };
@@ -57,8 +76,16 @@ struct block {
 	struct list_elem free_elem; /* Free list element. */
 };
 
+/* Block sizes of the descriptors, in increasing order. */
+static const size_t class_sizes[] = {
+	16, 32, 64, 128, 256, 512, 1024, 1536, 2048, 3072, 6144
+};
+
+/* Largest number of pages in a descriptor's arena. */
+#define ARENA_MAX_PAGES 8
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[sizeof class_sizes / sizeof *class_sizes];
 static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
@@ -67,18 +94,32 @@ static struct block *arena_to_block (struct arena *, size_t idx);
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+	for (desc_cnt = 0; desc_cnt < sizeof descs / sizeof *descs; desc_cnt++) {
+		struct desc *d = &descs[desc_cnt];
+		size_t arena_size;
+
+		/* Use the smallest arena that wastes at most an eighth
+		   of itself. */
+		d->block_size = class_sizes[desc_cnt];
+		for (d->arena_pages = 1; ; d->arena_pages *= 2) {
+			arena_size = d->arena_pages * PGSIZE - sizeof (struct arena);
+			if (arena_size % d->block_size <= arena_size / 8
+					|| d->arena_pages == ARENA_MAX_PAGES)
+				break;
+		}
+		d->blocks_per_arena = arena_size / d->block_size;
+		ASSERT (d->blocks_per_arena > 0);
 		list_init (&d->free_list);
 		lock_init (&d->lock);
 	}
 }
 
+/* Returns the number of pages in a big block of SIZE bytes. */
+static size_t
+big_block_pages (size_t size) {
+	return DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE);
+}
+
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
@@ -96,10 +137,12 @@ malloc (size_t size) {
 	for (d = descs; d < descs + desc_cnt; d++)
 		if (d->block_size >= size)
 			break;
-	if (d == descs + desc_cnt) {
-		/* SIZE is too big for any descriptor.
-		   Allocate enough pages to hold SIZE plus an arena. */
-		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+	if (d == descs + desc_cnt
+			|| d->block_size > big_block_pages (size) * PGSIZE) {
+		/* SIZE is too big for any descriptor, or whole pages fit
+		   it better.  Allocate enough pages to hold SIZE plus an
+		   arena. */
+		size_t page_cnt = big_block_pages (size);
 		a = palloc_get_multiple (0, page_cnt);
 		if (a == NULL)
 			return NULL;
@@ -118,12 +161,13 @@ malloc (size_t size) {
 	if (list_empty (&d->free_list)) {
 		size_t i;
 
-		/* Allocate a page. */
-		a = palloc_get_page (0);
+		/* Allocate the arena's pages. */
+		a = palloc_get_multiple (0, d->arena_pages);
 		if (a == NULL) {
 			lock_release (&d->lock);
 			return NULL;
 		}
+		palloc_set_owner (a, d->arena_pages, a);
 
 		/* Initialize arena and add its blocks to the free list. */
 		a->magic = ARENA_MAGIC;
@@ -173,8 +217,29 @@ block_size (void *block) {
 	return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
 }
 
+/* Tries to resize big block B to hold NEW_SIZE bytes without
+   moving it.  Returns true if successful. */
+static bool
+resize_big_block (struct block *b, size_t new_size) {
+	struct arena *a = block_to_arena (b);
+	size_t page_cnt = big_block_pages (new_size);
+
+	ASSERT (a->desc == NULL);
+
+	if (page_cnt < a->free_cnt)
+		palloc_free_multiple ((uint8_t *) a + page_cnt * PGSIZE,
+				a->free_cnt - page_cnt);
+	else if (page_cnt > a->free_cnt
+			&& !palloc_extend (a, a->free_cnt, page_cnt - a->free_cnt))
+		return false;
+	a->free_cnt = page_cnt;
+	return true;
+}
+
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
-   moving it in the process.
+   moving it in the process.  A block that already has room for
+   NEW_SIZE bytes stays put, and so does a big block that can grow
+   into the pages that follow it.
    If successful, returns the new block; on failure, returns a
    null pointer.
    A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
@@ -184,10 +249,19 @@ realloc (void *old_block, size_t new_size) {
 	if (new_size == 0) {
 		free (old_block);
 		return NULL;
-	} else {
-		void *new_block = malloc (new_size);
-		if (old_block != NULL && new_block != NULL) {
-			size_t old_size = block_size (old_block);
+	} else if (old_block == NULL)
+		return malloc (new_size);
+	else {
+		struct arena *a = block_to_arena (old_block);
+		size_t old_size = block_size (old_block);
+		void *new_block;
+
+		if (a->desc != NULL ? new_size <= old_size
+				: resize_big_block (old_block, new_size))
+			return old_block;
+
+		new_block = malloc (new_size);
+		if (new_block != NULL) {
 			size_t min_size = new_size < old_size ? new_size : old_size;
 			memcpy (new_block, old_block, min_size);
 			free (old_block);
@@ -197,13 +271,24 @@ realloc (void *old_block, size_t new_size) {
 }
 
 /* Frees block P, which must have been previously allocated with
-   malloc(), calloc(), or realloc(). */
+   malloc(), calloc(), or realloc(), or from a kmem_cache. */
 void
 free (void *p) {
 	if (p != NULL) {
 		struct block *b = p;
-		struct arena *a = block_to_arena (b);
-		struct desc *d = a->desc;
+		struct arena *a;
+		struct desc *d;
+
+		if (kmem_owns (p)) {
+			kmem_free (p);
+			return;
+		}
+		a = block_to_arena (b);
+		d = a->desc;
+
+#ifdef MEMTRACK
+		memtrack_forget (p, false);
+#endif
 
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
@@ -227,7 +312,7 @@ free (void *p) {
 					struct block *b = arena_to_block (a, i);
 					list_remove (&b->free_elem);
 				}
-				palloc_free_page (a);
+				palloc_free_multiple (a, d->arena_pages);
 			}
 
 			lock_release (&d->lock);
@@ -242,7 +327,11 @@ free (void *p) {
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
-	struct arena *a = pg_round_down (b);
+	struct arena *a = palloc_get_owner (b);
+
+	/* Big blocks' pages are not tagged. */
+	if (a == NULL)
+		a = pg_round_down (b);
 
 	/* Check that the arena is valid. */
 	ASSERT (a != NULL);
@@ -250,7 +339,7 @@ block_to_arena (struct block *b) {
 
 	/* Check that the block is properly aligned for the arena. */
 	ASSERT (a->desc == NULL
-			|| (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
+			|| ((uint8_t *) b - (uint8_t *) (a + 1)) % a->desc->block_size == 0);
 	ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
 
 	return a;
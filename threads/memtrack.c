@@ -0,0 +1,407 @@
+#include "threads/memtrack.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Kernel memory accounting and leak tracking.
+
+   Built only with -DMEMTRACK (`make MEMTRACK=1').  Every live
+   malloc() block and palloc() run is recorded, with the address
+   it was allocated from, its size and the thread that allocated
+   it, in an open-addressing hash table keyed by address.  Pages
+   that malloc() itself takes for its arenas are not recorded:
+   the blocks carved from them are.
+
+   memtrack_print() sums up live memory per subsystem, lists the
+   call sites holding the most memory and the allocations still
+   held on behalf of threads that have exited, which is where
+   leaks show up.  It runs from the `memstat' kernel command line
+   action and from interrupt 0x45, which user programs may raise
+   to take a snapshot at any point.  Caller addresses can be
+   turned into source lines with `backtrace kernel.o ADDR...'. */
+#ifdef MEMTRACK
+
+/* memtrack.h redirects these to us. */
+#undef malloc
+#undef calloc
+#undef realloc
+#undef palloc_get_page
+#undef palloc_get_multiple
+
+/* Number of hash table slots.  Must be a power of 2. */
+#define MT_SLOTS 16384
+
+/* Number of distinct call sites memtrack_print() can tell apart. */
+#define MT_CALLERS 256
+
+/* Number of leaked allocations memtrack_print() lists. */
+#define MT_LEAKS 32
+
+/* Highest thread id whose exit is remembered. */
+#define MT_TIDS 65536
+
+/* A live allocation.  24 bytes. */
+struct mt_entry {
+	uintptr_t addr;             /* Block or first page; 0 if free slot. */
+	uint32_t caller;            /* Return address, minus KERN_BASE. */
+	uint32_t size;              /* Bytes, or pages if PAGES. */
+	int32_t tid;                /* Thread that allocated it. */
+	uint8_t subsys;             /* enum memtrack_subsys. */
+	bool pages;                 /* From palloc() rather than malloc()? */
+};
+
+/* Memory held by one call site. */
+struct mt_caller {
+	uint32_t caller;            /* Return address, minus KERN_BASE. */
+	uint8_t subsys;             /* enum memtrack_subsys. */
+	size_t cnt;                 /* Live allocations. */
+	size_t bytes;               /* Live bytes, pages counted in full. */
+};
+
+static const char *subsys_names[MT_SUBSYS_CNT] = {
+	"threads", "filesys", "vm", "userprog", "other"
+};
+
+static struct spinlock mt_lock;
+static bool mt_ready;
+static struct mt_entry mt_table[MT_SLOTS];
+static size_t mt_used;                  /* Occupied slots. */
+static long long mt_dropped;            /* Allocations the full table missed. */
+static struct memtrack_counters mt_counters[MT_SUBSYS_CNT];
+static uint8_t mt_exited[MT_TIDS / 8];  /* Bitmap of exited tids. */
+
+/* Initializes the tracker.  Allocations made before this are not
+   recorded. */
+void
+memtrack_init (void) {
+	spin_lock_init (&mt_lock, "memtrack");
+	mt_ready = true;
+}
+
+/* Returns the subsystem that FILE, as given by __FILE__, belongs
+   to. */
+static enum memtrack_subsys
+subsys_of (const char *file) {
+	static const char *dirs[] = { "threads/", "filesys/", "vm/", "userprog/" };
+
+	if (strstr (file, "tests/") != NULL)
+		return MT_OTHER;
+	for (int i = 0; i < MT_OTHER; i++)
+		if (strstr (file, dirs[i]) != NULL)
+			return i;
+	return MT_OTHER;
+}
+
+/* Returns the hash table slot where ADDR's probe sequence
+   starts. */
+static size_t
+home_slot (uintptr_t addr) {
+	return hash_bytes (&addr, sizeof addr) & (MT_SLOTS - 1);
+}
+
+/* Returns the slot holding ADDR, or SIZE_MAX if none does.
+   mt_lock must be held. */
+static size_t
+find_slot (uintptr_t addr) {
+	size_t i;
+
+	for (i = home_slot (addr); mt_table[i].addr != 0; i = (i + 1) & (MT_SLOTS - 1))
+		if (mt_table[i].addr == addr)
+			return i;
+	return SIZE_MAX;
+}
+
+/* Empties slot I, moving later entries of the same probe run back
+   so that lookups never stop short at the hole.  mt_lock must be
+   held. */
+static void
+remove_slot (size_t i) {
+	size_t j = i;
+
+	for (;;) {
+		size_t home;
+
+		mt_table[i].addr = 0;
+		do {
+			j = (j + 1) & (MT_SLOTS - 1);
+			if (mt_table[j].addr == 0)
+				return;
+			home = home_slot (mt_table[j].addr);
+		} while (i <= j ? i < home && home <= j : i < home || home <= j);
+		mt_table[i] = mt_table[j];
+		i = j;
+	}
+}
+
+/* Records that CALLER in FILE allocated SIZE bytes, or SIZE pages
+   if PAGES, at P. */
+static void
+record (void *p, size_t size, bool pages, void *caller, const char *file) {
+	enum memtrack_subsys subsys;
+	struct memtrack_counters *c;
+	enum intr_level old_level;
+
+	if (p == NULL || !mt_ready)
+		return;
+
+	subsys = subsys_of (file);
+	c = &mt_counters[subsys];
+	old_level = spin_lock_irqsave (&mt_lock);
+	c->allocs++;
+	if (pages)
+		c->pages += size;
+	else
+		c->bytes += size;
+	if (mt_used < MT_SLOTS * 7 / 8) {
+		size_t i = home_slot ((uintptr_t) p);
+
+		while (mt_table[i].addr != 0)
+			i = (i + 1) & (MT_SLOTS - 1);
+		mt_table[i].addr = (uintptr_t) p;
+		mt_table[i].caller = (uintptr_t) caller - KERN_BASE;
+		mt_table[i].size = size;
+		mt_table[i].tid = thread_current ()->tid;
+		mt_table[i].subsys = subsys;
+		mt_table[i].pages = pages;
+		mt_used++;
+	} else
+		mt_dropped++;
+	spin_unlock_irqrestore (&mt_lock, old_level);
+}
+
+/* Forgets the allocation at ADDR: a malloc() block, or the first
+   of a run of pages if PAGES.  Unrecorded allocations are
+   ignored. */
+static void
+forget (uintptr_t addr, bool pages) {
+	enum intr_level old_level;
+	size_t i;
+
+	if (addr == 0 || !mt_ready)
+		return;
+
+	old_level = spin_lock_irqsave (&mt_lock);
+	i = find_slot (addr);
+	if (i != SIZE_MAX && mt_table[i].pages == pages) {
+		struct mt_entry *e = &mt_table[i];
+		struct memtrack_counters *c = &mt_counters[e->subsys];
+
+		c->frees++;
+		if (pages)
+			c->pages -= e->size;
+		else
+			c->bytes -= e->size;
+		remove_slot (i);
+		mt_used--;
+	}
+	spin_unlock_irqrestore (&mt_lock, old_level);
+}
+
+/* Forgets the allocation at P, which is being freed: a malloc()
+   block, or the first of a run of pages if PAGES. */
+void
+memtrack_forget (const void *p, bool pages) {
+	forget ((uintptr_t) p, pages);
+}
+
+/* malloc() on behalf of FILE. */
+void *
+memtrack_malloc (size_t size, const char *file) {
+	void *p = malloc (size);
+
+	record (p, size, false, __builtin_return_address (0), file);
+	return p;
+}
+
+/* calloc() on behalf of FILE. */
+void *
+memtrack_calloc (size_t a, size_t b, const char *file) {
+	void *p = calloc (a, b);
+
+	record (p, a * b, false, __builtin_return_address (0), file);
+	return p;
+}
+
+/* realloc() on behalf of FILE.  The resized block is charged to
+   the caller of realloc(). */
+void *
+memtrack_realloc (void *old_block, size_t new_size, const char *file) {
+	uintptr_t old_addr = (uintptr_t) old_block;
+	void *p = realloc (old_block, new_size);
+
+	if (p != NULL) {
+		forget (old_addr, false);
+		record (p, new_size, false, __builtin_return_address (0), file);
+	}
+	return p;
+}
+
+/* palloc_get_multiple() on behalf of FILE. */
+void *
+memtrack_palloc (enum palloc_flags flags, size_t page_cnt, const char *file) {
+	void *pages = palloc_get_multiple (flags, page_cnt);
+
+	record (pages, page_cnt, true, __builtin_return_address (0), file);
+	return pages;
+}
+
+/* Notes that thread TID has exited, so that memory still charged
+   to it shows up as a possible leak. */
+void
+memtrack_thread_exit (int tid) {
+	if (tid >= 0 && tid < MT_TIDS)
+		mt_exited[tid / 8] |= 1 << (tid % 8);
+}
+
+/* Returns true if thread TID is known to have exited. */
+static bool
+exited (int tid) {
+	return tid >= 0 && tid < MT_TIDS && (mt_exited[tid / 8] & (1 << (tid % 8)));
+}
+
+/* Returns the bytes taken by allocation E. */
+static size_t
+entry_bytes (const struct mt_entry *e) {
+	return e->pages ? (size_t) e->size * PGSIZE : e->size;
+}
+
+/* Copies the allocation counters of SUBSYS into C. */
+void
+memtrack_get_counters (enum memtrack_subsys subsys,
+		struct memtrack_counters *c) {
+	enum intr_level old_level;
+
+	ASSERT (subsys < MT_SUBSYS_CNT);
+	old_level = spin_lock_irqsave (&mt_lock);
+	*c = mt_counters[subsys];
+	spin_unlock_irqrestore (&mt_lock, old_level);
+}
+
+/* Returns the bytes still charged to thread TID, pages counted in
+   full. */
+size_t
+memtrack_held_by (int tid) {
+	enum intr_level old_level;
+	size_t bytes = 0;
+
+	old_level = spin_lock_irqsave (&mt_lock);
+	for (size_t s = 0; s < MT_SLOTS; s++)
+		if (mt_table[s].addr != 0 && mt_table[s].tid == tid)
+			bytes += entry_bytes (&mt_table[s]);
+	spin_unlock_irqrestore (&mt_lock, old_level);
+	return bytes;
+}
+
+/* Prints live memory per subsystem, the TOP_N call sites holding
+   the most memory, and the allocations still charged to threads
+   that have exited. */
+void
+memtrack_print (int top_n) {
+	/* Snapshots, so that printing happens without mt_lock. */
+	static struct mt_caller callers[MT_CALLERS];
+	static struct mt_entry leaks[MT_LEAKS];
+	static struct memtrack_counters counters[MT_SUBSYS_CNT];
+	size_t caller_cnt = 0, leak_cnt = 0, leak_bytes = 0, other_cnt = 0;
+	long long dropped;
+	enum intr_level old_level;
+	int i, n;
+
+	if (!mt_ready)
+		return;
+
+	old_level = spin_lock_irqsave (&mt_lock);
+	for (size_t s = 0; s < MT_SLOTS; s++) {
+		const struct mt_entry *e = &mt_table[s];
+		size_t j;
+
+		if (e->addr == 0)
+			continue;
+
+		/* Charge it to its call site. */
+		for (j = 0; j < caller_cnt; j++)
+			if (callers[j].caller == e->caller)
+				break;
+		if (j == caller_cnt && caller_cnt < MT_CALLERS) {
+			callers[j].caller = e->caller;
+			callers[j].subsys = e->subsys;
+			callers[j].cnt = callers[j].bytes = 0;
+			caller_cnt++;
+		}
+		if (j < caller_cnt) {
+			callers[j].cnt++;
+			callers[j].bytes += entry_bytes (e);
+		} else
+			other_cnt++;
+
+		if (exited (e->tid)) {
+			if (leak_cnt < MT_LEAKS)
+				leaks[leak_cnt] = *e;
+			leak_cnt++;
+			leak_bytes += entry_bytes (e);
+		}
+	}
+	memcpy (counters, mt_counters, sizeof counters);
+	dropped = mt_dropped;
+	spin_unlock_irqrestore (&mt_lock, old_level);
+
+	for (i = 0; i < MT_SUBSYS_CNT; i++)
+		printf ("Memtrack: %s: %lld allocs, %lld frees, "
+				"%zu bytes and %zu pages live\n", subsys_names[i],
+				counters[i].allocs, counters[i].frees,
+				counters[i].bytes, counters[i].pages);
+	if (dropped > 0)
+		printf ("Memtrack: %lld allocations not recorded, table full\n",
+				dropped);
+
+	printf ("Memtrack: top %d of %zu call sites by live bytes:\n",
+			top_n, caller_cnt);
+	for (n = 0; n < top_n; n++) {
+		struct mt_caller *best = NULL;
+
+		for (size_t j = 0; j < caller_cnt; j++)
+			if (callers[j].cnt > 0
+					&& (best == NULL || callers[j].bytes > best->bytes))
+				best = &callers[j];
+		if (best == NULL)
+			break;
+		printf ("  %#"PRIx64" (%s): %zu allocations, %zu bytes\n",
+				(uint64_t) KERN_BASE + best->caller,
+				subsys_names[best->subsys], best->cnt, best->bytes);
+		best->cnt = 0;
+	}
+	if (other_cnt > 0)
+		printf ("  (%zu allocations from other call sites)\n", other_cnt);
+
+	printf ("Memtrack: %zu allocations, %zu bytes, held by exited threads\n",
+			leak_cnt, leak_bytes);
+	for (size_t j = 0; j < leak_cnt && j < MT_LEAKS; j++)
+		printf ("  %#"PRIx64" from %#"PRIx64" (%s), tid %d: %zu %s\n",
+				(uint64_t) leaks[j].addr,
+				(uint64_t) KERN_BASE + leaks[j].caller,
+				subsys_names[leaks[j].subsys], leaks[j].tid,
+				(size_t) leaks[j].size, leaks[j].pages ? "pages" : "bytes");
+}
+
+/* Prints memory statistics for the top RAX call sites, or 10 if
+   RAX is 0. */
+static void
+memtrack_intr (struct intr_frame *f) {
+	memtrack_print (f->R.rax > 0 ? (int) f->R.rax : 10);
+}
+
+/* Lets anyone take a snapshot of kernel memory use by raising
+   interrupt 0x45. */
+void
+memtrack_register_intr (void) {
+	intr_register_int (0x45, 3, INTR_ON, memtrack_intr, "Memory Tracker");
+}
+#endif /* MEMTRACK */
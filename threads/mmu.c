@@ -1,58 +1,136 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
-static uint64_t *
-pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
-	int idx = PDX (va);
-	if (pdp) {
-		uint64_t *pte = (uint64_t *) pdp[idx];
-		if (!((uint64_t) pte & PTE_P)) {
-			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page)
-					pdp[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-				else
-					return NULL;
-			} else
-				return NULL;
-		}
-		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
-	}
-	return NULL;
+/* Process-context identifiers.
+ *
+ * With CR4.PCIDE set, the CPU tags TLB entries with the PCID in
+ * the low 12 bits of CR3, so a switch to another address space
+ * need not flush the TLB: the old space's entries stay cached,
+ * unused, until it runs again.
+ *
+ * Each CPU hands its few PCIDs (1 to CPU_PCID_CNT; the kernel's
+ * base_pml4 has 0) to the address spaces it ran last, recycling
+ * them in turn.  Since an address space may have changed, or died
+ * and had its page reused for a new one, while it was not running
+ * on a CPU, it is identified by a context ID that is never reused
+ * and carries a flush generation that goes up whenever one of its
+ * entries changes in a way that needs a TLB flush.  A CPU whose
+ * slot for the address space holds the current generation
+ * switches to it without a flush; otherwise it flushes that PCID.
+ * Both numbers live in PML4 entries above the kernel's mappings,
+ * and count in steps of 2 so that these never look present. */
+#define CR3_NOFLUSH (1ULL << 63)    /* Keep entries of the new PCID. */
+#define CR4_PCIDE (1 << 17)         /* Enable PCIDs. */
+#define PML4_CTX_SLOT 510           /* PML4 entry holding the context ID. */
+#define PML4_GEN_SLOT 511           /* PML4 entry holding the generation. */
+
+static bool pcid_enabled;           /* CR4.PCIDE set? */
+static bool invpcid_ok;             /* INVPCID supported? */
+static uint64_t last_ctx_id;        /* Last context ID handed out. */
+
+/* Statistics. */
+static long long switch_cnt;        /* Switches to user address spaces. */
+static long long noflush_cnt;       /* ...that kept the TLB. */
+static long long page_flush_cnt;    /* Single pages invalidated. */
+static long long full_flush_cnt;    /* Whole address spaces invalidated. */
+
+static bool is_active (uint64_t *pml4);
+
+/* Number of large pages split by split_entry(). */
+static long long split_cnt;
+
+/* Replaces the large-page entry *ENTRY, which maps SIZE bytes, by
+ * a table of entries for pages of the next smaller size that map
+ * the same memory with the same permissions.  Returns false if
+ * out of memory.
+ * The translation of every address stays the same, so TLB entries
+ * for the large page need not be flushed; they go away with the
+ * invlpg() that follows any later change to one of the new
+ * entries. */
+static bool
+split_entry (uint64_t *entry, uint64_t size) {
+	uint64_t *table = palloc_get_page (0);
+	uint64_t sub_size = size / (PGSIZE / sizeof (uint64_t));
+	uint64_t flags = *entry & PTE_FLAGS & ~PTE_PS;
+
+	ASSERT ((*entry & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS));
+	if (table == NULL)
+		return false;
+	for (unsigned i = 0; i < PGSIZE / sizeof (uint64_t); i++)
+		table[i] = (PTE_ADDR (*entry) + i * sub_size) | flags
+			| (sub_size > PGSIZE ? PTE_PS : 0);
+	*entry = vtop (table) | PTE_U | PTE_W | PTE_P;
+	split_cnt++;
+	return true;
+}
+
+/* Returns the number of large pages split so far. */
+long long
+pml4_split_cnt (void) {
+	return split_cnt;
 }
 
+/* Walks PML4 down to the entry that maps VA with pages of
+ * PAGE_SIZE bytes (PGSIZE, LARGE_PGSIZE or HUGE_PGSIZE) and
+ * returns its address.  A present large-page entry (one with
+ * PTE_PS set) met on the way ends the walk early and is returned
+ * instead, unless CREATE is true, in which case it is split.  If
+ * ENTRY_SIZE is nonnull, stores the size of the pages the
+ * returned entry maps in it.
+ * Missing page tables are created if CREATE is true; otherwise,
+ * or if memory allocation fails, returns a null pointer. */
 static uint64_t *
-pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
-	uint64_t *pte = NULL;
-	int idx = PDPE (va);
-	int allocated = 0;
-	if (pdpe) {
-		uint64_t *pde = (uint64_t *) pdpe[idx];
-		if (!((uint64_t) pde & PTE_P)) {
-			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page) {
-					pdpe[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-					allocated = 1;
-				} else
-					return NULL;
-			} else
-				return NULL;
+walk (uint64_t *pml4, uint64_t va, uint64_t page_size, bool create,
+		uint64_t *entry_size) {
+	static const unsigned shifts[] = { PML4SHIFT, PDPESHIFT, PDXSHIFT, PTXSHIFT };
+	uint64_t *created[3];
+	int created_cnt = 0;
+	uint64_t *table = pml4;
+
+	if (pml4 == NULL)
+		return NULL;
+
+	for (int level = 0; ; level++) {
+		uint64_t size = 1UL << shifts[level];
+		uint64_t *entry = &table[(va >> shifts[level]) & 0x1FF];
+
+		if (size == page_size || ((*entry & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)
+					&& !create)) {
+			if (entry_size != NULL)
+				*entry_size = size;
+			return entry;
 		}
-		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
+		if ((*entry & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)) {
+			if (!split_entry (entry, size))
+				goto fail;
+		} else if (!(*entry & PTE_P)) {
+			uint64_t *new_table = create ? palloc_get_page (PAL_ZERO) : NULL;
+			if (new_table == NULL)
+				goto fail;
+			*entry = vtop (new_table) | PTE_U | PTE_W | PTE_P;
+			created[created_cnt++] = entry;
+		}
+		table = ptov (PTE_ADDR (*entry));
 	}
-	if (pte == NULL && allocated) {
-		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
-		pdpe[idx] = 0;
+
+fail:
+	/* Undo what we did.  Splits are kept: they changed nothing. */
+	while (created_cnt > 0) {
+		uint64_t *e = created[--created_cnt];
+		palloc_free_page (ptov (PTE_ADDR (*e)));
+		*e = 0;
 	}
-	return pte;
+	return NULL;
 }
 
 /* Returns the address of the page table entry for virtual
@@ -60,32 +138,23 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a large page, returns the PDE or PDPE that
+ * maps it, which has PTE_PS set. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
-	uint64_t *pte = NULL;
-	int idx = PML4 (va);
-	int allocated = 0;
-	if (pml4e) {
-		uint64_t *pdpe = (uint64_t *) pml4e[idx];
-		if (!((uint64_t) pdpe & PTE_P)) {
-			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page) {
-					pml4e[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-					allocated = 1;
-				} else
-					return NULL;
-			} else
-				return NULL;
-		}
-		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
-	}
-	if (pte == NULL && allocated) {
-		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
-		pml4e[idx] = 0;
-	}
-	return pte;
+	return walk (pml4e, va, PGSIZE, create, NULL);
+}
+
+/* Like pml4e_walk(), but returns the entry that maps VA with pages
+ * of PAGE_SIZE bytes: a PTE for PGSIZE, a PDE for LARGE_PGSIZE or
+ * a PDPE for HUGE_PGSIZE. */
+uint64_t *
+pml4e_walk_size (uint64_t *pml4e, const uint64_t va, uint64_t page_size,
+		int create) {
+	ASSERT (page_size == PGSIZE || page_size == LARGE_PGSIZE
+			|| page_size == HUGE_PGSIZE);
+	return walk (pml4e, va, page_size, create, NULL);
 }
 
 /* Creates a new page map level 4 (pml4) has mappings for kernel
@@ -99,8 +168,12 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 uint64_t *
 pml4_create (void) {
 	uint64_t *pml4 = palloc_get_page (0);
-	if (pml4)
+	if (pml4) {
 		memcpy (pml4, base_pml4, PGSIZE);
+		pml4[PML4_CTX_SLOT] = __atomic_add_fetch (&last_ctx_id, 2,
+				__ATOMIC_RELAXED);
+		pml4[PML4_GEN_SLOT] = 0;
+	}
 	return pml4;
 }
 
@@ -121,12 +194,20 @@ pt_for_each (uint64_t *pt, pte_for_each_func *func, void *aux,
 	return true;
 }
 
+/* Large pages are passed to FUNC as their PDE or PDPE, which has
+   PTE_PS set. */
 static bool
 pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if (((uint64_t) pte) & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (((uint64_t) pte) & PTE_P && !func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -139,7 +220,12 @@ pdp_for_each (uint64_t *pdp,
 		pte_for_each_func *func, void *aux, unsigned pml4_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pde = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pde) & PTE_P)
+		if (((uint64_t) pde) & PTE_PS) {
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) i << PDPESHIFT));
+			if (((uint64_t) pde) & PTE_P && !func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pde) & PTE_P)
 			if (!pgdir_for_each ((uint64_t *) PTE_ADDR (pde), func,
 					 aux, pml4_index, i))
 				return false;
@@ -147,7 +233,8 @@ pdp_for_each (uint64_t *pdp,
 	return true;
 }
 
-/* Apply FUNC to each available pte entries including kernel's. */
+/* Apply FUNC to each available pte entries including kernel's.
+   A large page is visited once, through its PDE or PDPE. */
 bool
 pml4_for_each (uint64_t *pml4, pte_for_each_func *func, void *aux) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
@@ -173,7 +260,9 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+			palloc_free_multiple ((void *) PTE_ADDR (pte), LARGE_PGSIZE / PGSIZE);
+		else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -189,12 +278,18 @@ pdpe_destroy (uint64_t *pdpe) {
 	palloc_free_page ((void *) pdpe);
 }
 
-/* Destroys pml4e, freeing all the pages it references. */
+/* Destroys pml4e, freeing all the pages it references.
+ * PML4 must not be active on any CPU.  Then its pages need no TLB
+ * flush: without PCIDs, the CR3 load that deactivated it flushed
+ * them, and with PCIDs, they stay tagged with a context ID that is
+ * never activated again and are flushed when the CPU recycles the
+ * PCID. */
 void
 pml4_destroy (uint64_t *pml4) {
 	if (pml4 == NULL)
 		return;
 	ASSERT (pml4 != base_pml4);
+	ASSERT (!is_active (pml4));
 
 	/* if PML4 (vaddr) >= 1, it's kernel space by define. */
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
@@ -203,11 +298,147 @@ pml4_destroy (uint64_t *pml4) {
 	palloc_free_page ((void *) pml4);
 }
 
+/* Turns on PCIDs if the CPU supports them.  Must be called while
+ * base_pml4 is active with PCID 0.  Returns true if successful. */
+bool
+pml4_enable_pcid (void) {
+	uint32_t regs[4];
+
+	ASSERT ((rcr3 () & PGMASK) == 0);
+
+	cpuid (1, regs);
+	if (!(regs[2] & (1 << 17)))
+		return false;
+	cpuid (0, regs);
+	if (regs[0] >= 7) {
+		cpuid (7, regs);
+		invpcid_ok = (regs[1] & (1 << 10)) != 0;
+	}
+	lcr4 (rcr4 () | CR4_PCIDE);
+	pcid_enabled = true;
+	return true;
+}
+
+/* Returns true if PML4 is the running CPU's active page map. */
+static bool
+is_active (uint64_t *pml4) {
+	return (rcr3 () & ~(uint64_t) PGMASK) == vtop (pml4);
+}
+
+/* Returns the running CPU's PCID slot for PML4, or a null pointer
+ * if it has none.  Interrupts must be off. */
+static struct pcid_slot *
+find_pcid_slot (uint64_t *pml4) {
+	struct cpu *c = cpu_current ();
+
+	for (unsigned i = 0; i < CPU_PCID_CNT; i++)
+		if (c->pcids[i].ctx_id == pml4[PML4_CTX_SLOT])
+			return &c->pcids[i];
+	return NULL;
+}
+
+/* Flushes the TLB entries for the CNT user virtual pages in PAGES
+ * of PML4, whose mappings have just changed, or all of PML4's
+ * entries if CNT exceeds TLB_GATHER_MAX.  Other CPUs, and this one
+ * if it cannot reach the entries now, flush the whole PCID the
+ * next time they switch to PML4. */
+static void
+flush_pages (uint64_t *pml4, void *const pages[], size_t cnt) {
+	struct pcid_slot *slot = NULL;
+	enum intr_level old_level;
+	bool active, in_sync = false;
+	uint64_t pcid = 0;
+
+	if (cnt == 0)
+		return;
+
+	old_level = intr_disable ();
+	active = is_active (pml4);
+	if (pcid_enabled) {
+		slot = find_pcid_slot (pml4);
+		if (slot != NULL) {
+			in_sync = slot->tlb_gen == pml4[PML4_GEN_SLOT];
+			pcid = slot - cpu_current ()->pcids + 1;
+		}
+		pml4[PML4_GEN_SLOT] += 2;
+	}
+
+	if (active || (in_sync && invpcid_ok)) {
+		if (cnt > TLB_GATHER_MAX) {
+			/* Reloading CR3 without CR3_NOFLUSH flushes the
+			   active PCID. */
+			if (active)
+				lcr3 (rcr3 ());
+			else
+				invpcid (1, pcid, 0);
+			full_flush_cnt++;
+		} else {
+			for (size_t i = 0; i < cnt; i++) {
+				if (active)
+					invlpg ((uint64_t) pages[i]);
+				else
+					invpcid (0, pcid, (uint64_t) pages[i]);
+			}
+			page_flush_cnt += cnt;
+		}
+		if (in_sync)
+			slot->tlb_gen = pml4[PML4_GEN_SLOT];
+	}
+	intr_set_level (old_level);
+}
+
+/* Flushes the TLB entries for user virtual page VA of PML4, whose
+ * mapping has just changed. */
+static void
+flush_page (uint64_t *pml4, const void *va) {
+	void *page = (void *) va;
+	flush_pages (pml4, &page, 1);
+}
+
 /* Loads page directory PD into the CPU's page directory base
  * register. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	struct pcid_slot *slot;
+	enum intr_level old_level;
+	uint64_t cr3;
+
+	if (pml4 == NULL || !pcid_enabled) {
+		/* The kernel's mappings never change, so PCID 0 need
+		   not be flushed either. */
+		lcr3 (vtop (pml4 ? pml4 : base_pml4)
+				| (pcid_enabled ? CR3_NOFLUSH : 0));
+		return;
+	}
+
+	old_level = intr_disable ();
+	cr3 = vtop (pml4);
+	slot = find_pcid_slot (pml4);
+	if (slot == NULL) {
+		struct cpu *c = cpu_current ();
+
+		slot = &c->pcids[c->pcid_next];
+		c->pcid_next = (c->pcid_next + 1) % CPU_PCID_CNT;
+		slot->ctx_id = pml4[PML4_CTX_SLOT];
+	} else if (slot->tlb_gen == pml4[PML4_GEN_SLOT]) {
+		cr3 |= CR3_NOFLUSH;
+		noflush_cnt++;
+	}
+	slot->tlb_gen = pml4[PML4_GEN_SLOT];
+	switch_cnt++;
+	lcr3 (cr3 | (slot - cpu_current ()->pcids + 1));
+	intr_set_level (old_level);
+}
+
+/* Prints statistics about TLB flushes and address space
+ * switches. */
+void
+pml4_print_stats (void) {
+	printf ("Paging: %lld TLB page flushes, %lld full flushes\n",
+			page_flush_cnt, full_flush_cnt);
+	if (pcid_enabled)
+		printf ("Paging: %lld address space switches, %lld without "
+				"TLB flush\n", switch_cnt, noflush_cnt);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -219,10 +450,11 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	uint64_t page_size;
+	uint64_t *pte = walk (pml4, (uint64_t) uaddr, PGSIZE, false, &page_size);
 
 	if (pte && (*pte & PTE_P))
-		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
+		return ptov (PTE_ADDR (*pte)) + ((uint64_t) uaddr & (page_size - 1));
 	return NULL;
 }
 
@@ -243,28 +475,154 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		bool was_present = (*pte & PTE_P) != 0;
+
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (was_present)
+			flush_page (pml4, upage);
+	}
 	return pte != NULL;
 }
 
+/* Adds a mapping in PML4 from the 2 MB aligned user virtual
+ * region at UPAGE to the physically contiguous, 2 MB aligned
+ * frame at kernel virtual address KPAGE, with a single large-page
+ * entry.  No page in the region may be mapped yet.
+ * The mapping is split into 4 kB entries as soon as one of its
+ * pages is mapped or cleared on its own.
+ * Returns true if successful, false if memory allocation failed. */
+bool
+pml4_set_large_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde;
+
+	ASSERT ((uint64_t) upage % LARGE_PGSIZE == 0);
+	ASSERT (vtop (kpage) % LARGE_PGSIZE == 0);
+	ASSERT (is_user_vaddr ((uint8_t *) upage + LARGE_PGSIZE - 1));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pml4e_walk_size (pml4, (uint64_t) upage, LARGE_PGSIZE, 1);
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		/* Replace the empty page table left behind by earlier
+		   mappings in the region.  The CPU may have cached the
+		   entry that points to it, so the table is freed only
+		   after that is flushed. */
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+
+		ASSERT (!(*pde & PTE_PS));
+		for (unsigned i = 0; i < PGSIZE / sizeof (uint64_t); i++)
+			ASSERT (!(pt[i] & PTE_P));
+		*pde = vtop (kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+		flush_page (pml4, upage);
+		palloc_free_page (pt);
+	} else
+		*pde = vtop (kpage) | PTE_P | PTE_PS | (rw ? PTE_W : 0) | PTE_U;
+	return true;
+}
+
+/* Marks user virtual page UPAGE "not present" in PML4 without
+ * flushing the TLB.  Returns true if it was present.  A large page
+ * that was made not present as a whole counts as not mapped; it is
+ * never walked through, which would put an empty page table in
+ * its place. */
+static bool
+clear_entry (uint64_t *pml4, void *upage) {
+	uint64_t *pte;
+	uint64_t size;
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pte = walk (pml4, (uint64_t) upage, PGSIZE, false, &size);
+	if (pte == NULL || (*pte & PTE_P) == 0)
+		return false;
+	if (size > PGSIZE) {
+		uint64_t *split = pml4e_walk (pml4, (uint64_t) upage, true);
+		if (split != NULL)
+			pte = split;
+	}
+	*pte &= ~PTE_P;
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
  * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
+ * If UPAGE lies in a large page, the large page is split first.
+ * Should that fail for lack of memory, the whole large page is
+ * marked "not present" instead, so its other pages fault too.
+ * UPAGE need not be mapped.
+ * To clear many pages, use a TLB gather instead. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
-	uint64_t *pte;
-	ASSERT (pg_ofs (upage) == 0);
-	ASSERT (is_user_vaddr (upage));
+	if (clear_entry (pml4, upage))
+		flush_page (pml4, upage);
+}
 
-	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+/* TLB gathers.
+ *
+ * Clearing pages one by one with pml4_clear_page() costs a TLB
+ * invalidation each.  A caller that unmaps many pages at once,
+ * such as munmap(), process exit or eviction, instead does:
+ *
+ *    struct tlb_gather tlb;
+ *    tlb_gather_init (&tlb, pml4);
+ *    for (...)
+ *      tlb_gather_clear_page (&tlb, upage);
+ *    tlb_gather_finish (&tlb);
+ *
+ * and the TLB is flushed once, at the end: page by page for up to
+ * TLB_GATHER_MAX pages, otherwise all at once.  The pages must not
+ * be freed before tlb_gather_finish() returns, since the TLB may
+ * still map them.  Callers that change entries themselves, e.g. to
+ * write-protect them, record the pages with tlb_gather_add();
+ * tlb_gather_clear_accessed() does so for accessed bits. */
 
-	if (pte != NULL && (*pte & PTE_P) != 0) {
-		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
-	}
+/* Initializes TLB to gather page clearings in PML4. */
+void
+tlb_gather_init (struct tlb_gather *tlb, uint64_t *pml4) {
+	tlb->pml4 = pml4;
+	tlb->cnt = 0;
+}
+
+/* Adds user virtual page UPAGE, whose entry the caller changed in
+ * a way that needs a TLB flush, to TLB. */
+void
+tlb_gather_add (struct tlb_gather *tlb, void *upage) {
+	if (tlb->cnt < TLB_GATHER_MAX)
+		tlb->pages[tlb->cnt] = upage;
+	tlb->cnt++;
+}
+
+/* Like pml4_clear_page(), but defers the TLB flush to
+ * tlb_gather_finish(). */
+void
+tlb_gather_clear_page (struct tlb_gather *tlb, void *upage) {
+	if (clear_entry (tlb->pml4, upage))
+		tlb_gather_add (tlb, upage);
+}
+
+/* Clears the accessed bit of user virtual page UPAGE in TLB's page
+ * map, deferring the TLB flush to tlb_gather_finish().  Returns
+ * true if the bit was set. */
+bool
+tlb_gather_clear_accessed (struct tlb_gather *tlb, void *upage) {
+	uint64_t *pte = pml4e_walk (tlb->pml4, (uint64_t) upage, false);
+
+	if (pte == NULL || (*pte & PTE_A) == 0)
+		return false;
+	*pte &= ~(uint64_t) PTE_A;
+	tlb_gather_add (tlb, upage);
+	return true;
+}
+
+/* Flushes the TLB entries for the pages gathered in TLB, which may
+ * then be reused. */
+void
+tlb_gather_finish (struct tlb_gather *tlb) {
+	flush_pages (tlb->pml4, tlb->pages, tlb->cnt);
+	tlb->cnt = 0;
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
@@ -288,8 +646,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		flush_page (pml4, vpage);
 	}
 }
 
@@ -314,7 +671,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		flush_page (pml4, vpage);
 	}
 }
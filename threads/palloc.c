@@ -7,11 +7,18 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
+#ifdef MEMTRACK
+/* Define the real functions; memtrack.c wraps them. */
+#undef palloc_get_page
+#undef palloc_get_multiple
+#endif
+
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
    hands out smaller chunks.
@@ -24,13 +31,86 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed by a binary buddy allocator.  Free memory
+   is kept as blocks of 2**ORDER pages, for ORDER up to
+   PALLOC_MAX_ORDER, each aligned to its own size in physical
+   memory, on one free list per order.  A request for N pages
+   takes the smallest sufficient block, splitting larger blocks
+   as needed, and gives back the pages beyond N.  A freed block
+   is merged with its "buddy", the other half of the block of the
+   next order up, whenever that buddy is free too.  Both take
+   O(PALLOC_MAX_ORDER) steps.  Free blocks are linked through an
+   array of list_elems, one per page, kept beside the pool's bitmap,
+   so the allocator never writes to free memory.
+
+   Whether a page is free is read off orders[], by finding the
+   free block that contains it.  Debug builds also keep a bitmap
+   of used pages beside it so that allocations and frees can be
+   cross-checked.
+
+   Each page also has an owner tag, null unless its allocator sets
+   one with palloc_set_owner(), that lets a sub-allocator such as
+   malloc() map any address back to the object that owns its page.
+
+   Single pages, by far the most common request, are served from a
+   small per-CPU LIFO cache ("magazine") in front of each pool.  It
+   is refilled from and drained to the buddy allocator
+   PCACHE_BATCH pages at a time, so most single-page allocations and
+   frees take neither the pool lock nor a trip through the free
+   lists, and a freed page is handed out again while it is still
+   warm in the CPU cache.  A CPU's magazines are protected by
+   turning interrupts off.
+
+   Finally, the idle thread zeroes up to ZERO_POOL_PAGES free pages
+   of each pool ahead of time (see palloc_zero_idle()), and
+   single-page PAL_ZERO requests take one of those first instead
+   of clearing a page on the caller's path. */
+
+/* Per-CPU cache of free single pages. */
+#define PCACHE_SIZE 32                  /* Capacity, in pages. */
+#define PCACHE_BATCH 16                 /* Pages moved per refill or drain. */
+
+struct page_cache {
+	unsigned cnt;                       /* Number of cached pages. */
+	size_t pages[PCACHE_SIZE];          /* Cached page indexes, hottest last. */
+};
+
+/* Page cache statistics. */
+struct page_cache_stats {
+	long long hits;                     /* Allocations served from a cache. */
+	long long misses;                   /* Allocations that needed a refill. */
+	long long refills;                  /* Batches moved into a cache. */
+	long long drains;                   /* Batches moved out of a cache. */
+	long long zero_hits;                /* PAL_ZERO pages that were pre-zeroed. */
+	long long zero_misses;              /* PAL_ZERO pages zeroed on demand. */
+	long long zeroed;                   /* Pages zeroed by the idle thread. */
+};
+
+/* Number of pre-zeroed pages the idle thread keeps per pool. */
+#define ZERO_POOL_PAGES 64
 
 /* A memory pool. */
 struct pool {
-	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
+	struct spinlock lock;           /* Mutual exclusion. */
+#ifndef NDEBUG
+	struct bitmap *used_map;        /* Bitmap of used pages, for checking. */
+#endif
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Number of pages in pool. */
+	uint8_t *orders;                /* Per page: 1 + order if the page
+	                                   starts a free block, else 0. */
+	struct list_elem *elems;        /* Per page: free list element. */
+	void **owners;                  /* Per page: owner tag, or null. */
+	uint16_t *shares;               /* Per page: references beyond the first. */
+	struct list free_lists[PALLOC_ORDERS]; /* Free blocks, by order. */
+	size_t free_cnt[PALLOC_ORDERS]; /* Number of blocks on each list. */
+
+	struct page_cache caches[NCPU_MAX]; /* Per-CPU single page caches. */
+	struct list zeroed;             /* Pre-zeroed pages, linked by elems. */
+	size_t zeroed_cnt;              /* Number of pages on `zeroed'. */
+	struct page_cache_stats stats;  /* Page cache statistics. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +118,21 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Pre-zero pages in the idle thread? */
+bool palloc_prezero = true;
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of (void *page);
+static bool alloc_pages (struct pool *, size_t page_cnt, size_t *page_idx);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void take_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static bool pages_free (const struct pool *, size_t page_idx, size_t page_cnt);
+static bool cache_get (struct pool *, size_t *page_idx);
+static void cache_put (struct pool *, size_t page_idx);
+static void cache_drain (struct pool *, struct page_cache *, unsigned cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,16 +310,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool->page_cnt * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_pages (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_pages (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -262,20 +353,50 @@ palloc_init (void) {
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
+	enum intr_level old_level;
+	bool zeroed = false;
+	size_t page_idx;
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
+	if (page_cnt == 0)
+		return NULL;
+
+	old_level = intr_disable ();
+	if (page_cnt == 1 && (flags & PAL_ZERO) && !list_empty (&pool->zeroed)) {
+		page_idx = list_pop_front (&pool->zeroed) - pool->elems;
+		pool->zeroed_cnt--;
 		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+		zeroed = true;
+	} else if (page_cnt == 1 && cache_get (pool, &page_idx))
+		pages = pool->base + PGSIZE * page_idx;
+	else {
+		bool success;
+
+		spin_lock (&pool->lock);
+		success = alloc_pages (pool, page_cnt, &page_idx);
+		spin_unlock (&pool->lock);
+
+		/* Pages sitting in this CPU's caches may be all that keeps
+		   the request from succeeding. */
+		if (!success) {
+			palloc_drain_caches ();
+			spin_lock (&pool->lock);
+			success = alloc_pages (pool, page_cnt, &page_idx);
+			spin_unlock (&pool->lock);
+		}
+		pages = success ? pool->base + PGSIZE * page_idx : NULL;
+	}
+	intr_set_level (old_level);
 
 	if (pages) {
-		if (flags & PAL_ZERO)
-			memset (pages, 0, PGSIZE * page_cnt);
+		if (flags & PAL_ZERO) {
+			if (zeroed)
+				pool->stats.zero_hits++;
+			else {
+				pool->stats.zero_misses++;
+				memset (pages, 0, PGSIZE * page_cnt);
+			}
+		}
 	} else {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
@@ -296,30 +417,55 @@ palloc_get_page (enum palloc_flags flags) {
 	return palloc_get_multiple (flags, 1);
 }
 
-/* Frees the PAGE_CNT pages starting at PAGES. */
+/* Drops one of the extra references to page PAGE_IDX in POOL.
+   Returns false if there were none. */
+static bool
+unshare_page (struct pool *pool, size_t page_idx) {
+	uint16_t *shares = &pool->shares[page_idx];
+	uint16_t old = __atomic_load_n (shares, __ATOMIC_RELAXED);
+
+	do {
+		if (old == 0)
+			return false;
+	} while (!__atomic_compare_exchange_n (shares, &old, old - 1, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+	return true;
+}
+
+/* Frees the PAGE_CNT pages starting at PAGES.  A single page
+   shared with palloc_share_page() is only freed by its last
+   holder. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
 	struct pool *pool;
+	enum intr_level old_level;
 	size_t page_idx;
 
 	ASSERT (pg_ofs (pages) == 0);
 	if (pages == NULL || page_cnt == 0)
 		return;
 
-	if (page_from_pool (&kernel_pool, pages))
-		pool = &kernel_pool;
-	else if (page_from_pool (&user_pool, pages))
-		pool = &user_pool;
-	else
-		NOT_REACHED ();
-
+	pool = pool_of (pages);
 	page_idx = pg_no (pages) - pg_no (pool->base);
+	if (page_cnt == 1 && unshare_page (pool, page_idx))
+		return;
+	memset (&pool->owners[page_idx], 0, page_cnt * sizeof (void *));
+#ifdef MEMTRACK
+	memtrack_forget (pages, true);
+#endif
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1) {
+		old_level = intr_disable ();
+		cache_put (pool, page_idx);
+		intr_set_level (old_level);
+	} else {
+		old_level = spin_lock_irqsave (&pool->lock);
+		free_pages (pool, page_idx, page_cnt);
+		spin_unlock_irqrestore (&pool->lock, old_level);
+	}
 }
 
 /* Frees the page at PAGE. */
@@ -328,23 +474,241 @@ palloc_free_page (void *page) {
 	palloc_free_multiple (page, 1);
 }
 
+/* Tries to extend the PAGE_CNT pages allocated at PAGES by the
+   EXTRA_CNT pages that follow them.  Returns true if those pages
+   were free and now belong to the caller, who frees all
+   PAGE_CNT + EXTRA_CNT pages together or separately later on,
+   false if they were not free, in which case nothing changes.
+   The new pages are not zeroed. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t extra_cnt) {
+	struct pool *pool;
+	enum intr_level old_level;
+	size_t page_idx;
+	bool success = false;
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (page_cnt > 0);
+
+	pool = pool_of (pages);
+	page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+	if (extra_cnt == 0)
+		return true;
+	if (page_idx + extra_cnt > pool->page_cnt)
+		return false;
+
+	old_level = spin_lock_irqsave (&pool->lock);
+	if (pages_free (pool, page_idx, extra_cnt)) {
+		take_pages (pool, page_idx, extra_cnt);
+#ifndef NDEBUG
+		ASSERT (bitmap_none (pool->used_map, page_idx, extra_cnt));
+		bitmap_set_multiple (pool->used_map, page_idx, extra_cnt, true);
+#endif
+		success = true;
+	}
+	spin_unlock_irqrestore (&pool->lock, old_level);
+	return success;
+}
+
+/* Adds a reference to the allocated page PAGE, so that it takes
+   one more palloc_free_page() to free it.  Lets processes share
+   pages, e.g. copy-on-write after fork(). */
+void
+palloc_share_page (void *page) {
+	struct pool *pool = pool_of (page);
+	size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+	ASSERT (pg_ofs (page) == 0);
+	ASSERT (pool->shares[page_idx] < UINT16_MAX);
+	__atomic_add_fetch (&pool->shares[page_idx], 1, __ATOMIC_RELAXED);
+}
+
+/* Returns the number of references to the allocated page PAGE:
+   1 unless it is shared. */
+size_t
+palloc_page_refs (const void *page) {
+	struct pool *pool = pool_of ((void *) page);
+
+	return 1 + __atomic_load_n (&pool->shares[pg_no (page)
+			- pg_no (pool->base)], __ATOMIC_RELAXED);
+}
+
+/* Tags each of the PAGE_CNT allocated pages at PAGES with OWNER,
+   which palloc_get_owner() returns for any address in them until
+   they are freed. */
+void
+palloc_set_owner (void *pages, size_t page_cnt, void *owner) {
+	struct pool *pool = pool_of (pages);
+	size_t page_idx = pg_no (pages) - pg_no (pool->base);
+
+	ASSERT (pg_ofs (pages) == 0);
+	ASSERT (page_idx + page_cnt <= pool->page_cnt);
+
+	for (size_t i = 0; i < page_cnt; i++)
+		pool->owners[page_idx + i] = owner;
+}
+
+/* Returns the owner tag of the page containing ADDR, or a null
+   pointer if none was set since the page was allocated. */
+void *
+palloc_get_owner (const void *addr) {
+	struct pool *pool = pool_of ((void *) addr);
+
+	return pool->owners[pg_no (addr) - pg_no (pool->base)];
+}
+
+/* Returns the number of free blocks of 2**ORDER pages in the
+   user pool if PAL_USER is set in FLAGS, otherwise in the kernel
+   pool. */
+size_t
+palloc_free_blocks (enum palloc_flags flags, int order) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+	ASSERT (order >= 0 && order < PALLOC_ORDERS);
+	return pool->free_cnt[order];
+}
+
+/* Returns the pages in the current CPU's page caches, and the
+   pre-zeroed pages, to the buddy allocator. */
+void
+palloc_drain_caches (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	enum intr_level old_level = intr_disable ();
+
+	for (int i = 0; i < 2; i++) {
+		struct pool *pool = pools[i];
+		struct page_cache *c = &pool->caches[cpu_current ()->id];
+
+		cache_drain (pool, c, c->cnt);
+		spin_lock (&pool->lock);
+		while (!list_empty (&pool->zeroed))
+			free_pages (pool, list_pop_front (&pool->zeroed) - pool->elems, 1);
+		pool->zeroed_cnt = 0;
+		spin_unlock (&pool->lock);
+	}
+	intr_set_level (old_level);
+}
+
+/* Zeroes one free page for a future PAL_ZERO request, if a pool
+   is short of pre-zeroed pages.  Returns false if there was
+   nothing to do.
+
+   Called by the idle thread with interrupts off.  They are turned
+   on while the page is cleared, so that the idle thread holds up
+   interrupts and newly ready threads for at most one page. */
+bool
+palloc_zero_idle (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!palloc_prezero)
+		return false;
+	for (int i = 0; i < 2; i++) {
+		struct pool *pool = pools[i];
+		size_t page_idx;
+		bool success;
+
+		if (pool->zeroed_cnt >= ZERO_POOL_PAGES)
+			continue;
+
+		spin_lock (&pool->lock);
+		success = alloc_pages (pool, 1, &page_idx);
+		spin_unlock (&pool->lock);
+		if (!success)
+			continue;
+
+		/* Nobody else knows about the page until it is listed. */
+		intr_enable ();
+		memset (pool->base + PGSIZE * page_idx, 0, PGSIZE);
+		intr_disable ();
+
+		list_push_back (&pool->zeroed, &pool->elems[page_idx]);
+		pool->zeroed_cnt++;
+		pool->stats.zeroed++;
+		return true;
+	}
+	return false;
+}
+
+/* Prints the number of free blocks of each order in each pool,
+   and how well its page caches did. */
+void
+palloc_print_stats (void) {
+	struct pool *pools[] = { &kernel_pool, &user_pool };
+	const char *names[] = { "kernel", "user" };
+
+	for (int i = 0; i < 2; i++) {
+		struct page_cache_stats *s = &pools[i]->stats;
+		long long lookups = s->hits + s->misses;
+		size_t free_pages = 0;
+
+		printf ("Palloc: %s pool free blocks by order:", names[i]);
+		for (int order = 0; order < PALLOC_ORDERS; order++) {
+			printf (" %zu", pools[i]->free_cnt[order]);
+			free_pages += pools[i]->free_cnt[order] << order;
+		}
+		printf (" (%zu of %zu pages free)\n", free_pages, pools[i]->page_cnt);
+		printf ("Palloc: %s page cache: %lld hits, %lld misses (%lld%% hits), "
+				"%lld refills, %lld drains\n", names[i], s->hits, s->misses,
+				lookups > 0 ? s->hits * 100 / lookups : 0, s->refills, s->drains);
+		printf ("Palloc: %s pre-zeroed pages: %lld of %lld PAL_ZERO pages "
+				"(%lld%%), %lld zeroed while idle\n", names[i], s->zero_hits,
+				s->zero_hits + s->zero_misses,
+				s->zero_hits + s->zero_misses > 0
+				? s->zero_hits * 100 / (s->zero_hits + s->zero_misses) : 0,
+				s->zeroed);
+	}
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map and per-page metadata at its
+     base.  Calculate the space needed for them
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
+#ifndef NDEBUG
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
-
-	lock_init(&p->lock);
+#else
+	size_t bm_pages = 0;
+#endif
+	size_t order_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	size_t elem_pages = DIV_ROUND_UP (pgcnt * sizeof (struct list_elem), PGSIZE)
+		* PGSIZE;
+	size_t owner_pages = DIV_ROUND_UP (pgcnt * sizeof (void *), PGSIZE) * PGSIZE;
+	size_t share_pages = DIV_ROUND_UP (pgcnt * sizeof (uint16_t), PGSIZE)
+		* PGSIZE;
+
+	spin_lock_init (&p->lock, "palloc pool");
+#ifndef NDEBUG
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+#endif
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->orders = *bm_base + bm_pages;
+	p->elems = *bm_base + bm_pages + order_pages;
+	p->owners = *bm_base + bm_pages + order_pages + elem_pages;
+	p->shares = *bm_base + bm_pages + order_pages + elem_pages + owner_pages;
+	for (int order = 0; order < PALLOC_ORDERS; order++) {
+		list_init (&p->free_lists[order]);
+		p->free_cnt[order] = 0;
+	}
 
+#ifndef NDEBUG
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
-
-	*bm_base += bm_pages;
+#endif
+	memset (p->orders, 0, pgcnt);
+	memset (p->owners, 0, pgcnt * sizeof (void *));
+	memset (p->shares, 0, pgcnt * sizeof (uint16_t));
+	memset (p->caches, 0, sizeof p->caches);
+	list_init (&p->zeroed);
+	p->zeroed_cnt = 0;
+	memset (&p->stats, 0, sizeof p->stats);
+
+	*bm_base += bm_pages + order_pages + elem_pages + owner_pages
+		+ share_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -353,6 +717,302 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool->page_cnt;
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the pool that PAGE was allocated from. */
+static struct pool *
+pool_of (void *page) {
+	if (page_from_pool (&kernel_pool, page))
+		return &kernel_pool;
+	else if (page_from_pool (&user_pool, page))
+		return &user_pool;
+	else
+		NOT_REACHED ();
+}
+
+/* Returns the free list element of page PAGE_IDX of POOL. */
+static struct list_elem *
+block_elem (struct pool *pool, size_t page_idx) {
+	return &pool->elems[page_idx];
+}
+
+/* Returns the largest order a block starting at page PAGE_IDX of
+   POOL may have, given that blocks are aligned to their size in
+   physical memory. */
+static int
+max_order_at (const struct pool *pool, size_t page_idx) {
+	size_t page_no = pg_no (pool->base) + page_idx;
+	int order = 0;
+
+	while (order < PALLOC_MAX_ORDER && (page_no & (1 << order)) == 0)
+		order++;
+	return order;
+}
+
+/* Returns the index of the buddy of the 2**ORDER page block at
+   PAGE_IDX in POOL, or SIZE_MAX if the buddy lies outside POOL. */
+static size_t
+buddy_of (const struct pool *pool, size_t page_idx, int order) {
+	size_t base_no = pg_no (pool->base);
+	size_t buddy_no = (base_no + page_idx) ^ ((size_t) 1 << order);
+
+	if (buddy_no < base_no || buddy_no + ((size_t) 1 << order) > base_no + pool->page_cnt)
+		return SIZE_MAX;
+	return buddy_no - base_no;
+}
+
+/* Adds the free 2**ORDER page block at PAGE_IDX to POOL's free
+   lists, without merging it. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order) {
+	pool->orders[page_idx] = order + 1;
+	list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+	pool->free_cnt[order]++;
+}
+
+/* Removes the free 2**ORDER page block at PAGE_IDX from POOL's
+   free lists. */
+static void
+remove_block (struct pool *pool, size_t page_idx, int order) {
+	ASSERT (pool->orders[page_idx] == order + 1);
+
+	pool->orders[page_idx] = 0;
+	list_remove (block_elem (pool, page_idx));
+	pool->free_cnt[order]--;
+}
+
+/* Frees the 2**ORDER page block at PAGE_IDX in POOL, merging it
+   with its buddy for as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) {
+	while (order < PALLOC_MAX_ORDER) {
+		size_t buddy = buddy_of (pool, page_idx, order);
+		if (buddy == SIZE_MAX || pool->orders[buddy] != order + 1)
+			break;
+		remove_block (pool, buddy, order);
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	push_block (pool, page_idx, order);
+}
+
+/* Frees PAGE_CNT pages starting at PAGE_IDX in POOL, as the
+   fewest aligned blocks that cover them. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	ASSERT (page_idx + page_cnt <= pool->page_cnt);
+#ifndef NDEBUG
+	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+#endif
+
+	while (page_cnt > 0) {
+		int order = max_order_at (pool, page_idx);
+		while (((size_t) 1 << order) > page_cnt)
+			order--;
+		free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Returns the index of the free block in POOL that contains
+   page PAGE_IDX and stores its order in *ORDER, or returns
+   SIZE_MAX if the page is not free.  Pages held in a per-CPU
+   cache or on the zeroed list count as allocated. */
+static size_t
+free_block_of (const struct pool *pool, size_t page_idx, int *order) {
+	for (int k = 0; k < PALLOC_ORDERS; k++) {
+		size_t mask = ((size_t) 1 << k) - 1;
+		size_t head_no = (pg_no (pool->base) + page_idx) & ~mask;
+		size_t head;
+
+		if (head_no < pg_no (pool->base))
+			break;
+		head = head_no - pg_no (pool->base);
+		if (pool->orders[head] == k + 1) {
+			*order = k;
+			return head;
+		}
+	}
+	return SIZE_MAX;
+}
+
+/* Returns true if all PAGE_CNT pages starting at PAGE_IDX in
+   POOL are free, walking the range one free block at a time. */
+static bool
+pages_free (const struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+	size_t i = page_idx;
+
+	while (i < end) {
+		int order;
+		size_t head = free_block_of (pool, i, &order);
+		if (head == SIZE_MAX)
+			return false;
+		i = head + ((size_t) 1 << order);
+	}
+	return true;
+}
+
+/* Takes the PAGE_CNT free pages starting at PAGE_IDX out of
+   POOL's free lists, freeing again any part of the blocks that
+   hold them that lies outside the range. */
+static void
+take_pages (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	size_t end = page_idx + page_cnt;
+	size_t i = page_idx;
+
+	while (i < end) {
+		size_t head, head_end;
+		int order;
+
+		head = free_block_of (pool, i, &order);
+		ASSERT (head != SIZE_MAX);
+
+		remove_block (pool, head, order);
+		head_end = head + ((size_t) 1 << order);
+		if (head < i) {
+#ifndef NDEBUG
+			bitmap_set_multiple (pool->used_map, head, i - head, true);
+#endif
+			free_pages (pool, head, i - head);
+		}
+		if (head_end > end) {
+#ifndef NDEBUG
+			bitmap_set_multiple (pool->used_map, end, head_end - end, true);
+#endif
+			free_pages (pool, end, head_end - end);
+			head_end = end;
+		}
+		i = head_end;
+	}
+}
+
+/* Takes a page from the current CPU's cache for POOL, refilling
+   the cache first if it is empty, and stores its index in
+   *PAGE_IDX.  Returns false if POOL is out of pages.  Interrupts
+   must be off. */
+static bool
+cache_get (struct pool *pool, size_t *page_idx) {
+	struct page_cache *c = &pool->caches[cpu_current ()->id];
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (c->cnt > 0)
+		pool->stats.hits++;
+	else {
+		pool->stats.misses++;
+		spin_lock (&pool->lock);
+		while (c->cnt < PCACHE_BATCH && alloc_pages (pool, 1, &c->pages[c->cnt]))
+			c->cnt++;
+		spin_unlock (&pool->lock);
+		if (c->cnt == 0)
+			return false;
+		pool->stats.refills++;
+	}
+	*page_idx = c->pages[--c->cnt];
+	return true;
+}
+
+/* Puts page PAGE_IDX of POOL on top of the current CPU's cache,
+   first draining the coldest pages to the buddy allocator if the
+   cache is full.  Interrupts must be off. */
+static void
+cache_put (struct pool *pool, size_t page_idx) {
+	struct page_cache *c = &pool->caches[cpu_current ()->id];
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (c->cnt == PCACHE_SIZE)
+		cache_drain (pool, c, PCACHE_BATCH);
+	c->pages[c->cnt++] = page_idx;
+}
+
+/* Returns the CNT coldest pages of cache C to POOL.  Interrupts
+   must be off. */
+static void
+cache_drain (struct pool *pool, struct page_cache *c, unsigned cnt) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (cnt <= c->cnt);
+
+	if (cnt == 0)
+		return;
+	spin_lock (&pool->lock);
+	for (unsigned i = 0; i < cnt; i++)
+		free_pages (pool, c->pages[i], 1);
+	spin_unlock (&pool->lock);
+	memmove (c->pages, c->pages + cnt, (c->cnt - cnt) * sizeof *c->pages);
+	c->cnt -= cnt;
+	pool->stats.drains++;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and stores the
+   index of the first one in *PAGE_IDX.  Returns false if POOL
+   has no free run that long. */
+static bool
+alloc_pages (struct pool *pool, size_t page_cnt, size_t *page_idx) {
+	int order = 0, k;
+	size_t idx;
+
+	while (((size_t) 1 << order) < page_cnt && order <= PALLOC_MAX_ORDER)
+		order++;
+
+	if (order > PALLOC_MAX_ORDER) {
+		/* Bigger than any block.  Look for a run of adjacent free
+		   blocks, walking the pool one block at a time. */
+		size_t run_start = 0, run_len = 0;
+
+		for (idx = 0; idx < pool->page_cnt && run_len < page_cnt; ) {
+			if (pool->orders[idx] != 0) {
+				size_t len = (size_t) 1 << (pool->orders[idx] - 1);
+				if (run_len == 0)
+					run_start = idx;
+				run_len += len;
+				idx += len;
+			} else {
+				run_len = 0;
+				idx++;
+			}
+		}
+		if (run_len < page_cnt)
+			return false;
+		take_pages (pool, run_start, page_cnt);
+		idx = run_start;
+	} else {
+		for (k = order; k < PALLOC_ORDERS; k++)
+			if (!list_empty (&pool->free_lists[k]))
+				break;
+		if (k == PALLOC_ORDERS)
+			return false;
+
+		idx = list_front (&pool->free_lists[k]) - pool->elems;
+		remove_block (pool, idx, k);
+
+		/* Split off upper halves until the block is just big
+		   enough.  Their buddies are in use, so they cannot merge. */
+		while (k > order) {
+			k--;
+			push_block (pool, idx + ((size_t) 1 << k), k);
+		}
+
+		/* Give back the pages we do not need. */
+		if (((size_t) 1 << order) > page_cnt) {
+			size_t extra = ((size_t) 1 << order) - page_cnt;
+#ifndef NDEBUG
+			bitmap_set_multiple (pool->used_map, idx + page_cnt, extra, true);
+#endif
+			free_pages (pool, idx + page_cnt, extra);
+		}
+	}
+
+#ifndef NDEBUG
+	ASSERT (bitmap_none (pool->used_map, idx, page_cnt));
+	bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+#endif
+	*page_idx = idx;
+	return true;
+}
@@ -0,0 +1,306 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   malloc() rounds every request up to a power of 2, so a 600-byte
+   struct inode occupies a 1 kB block.  A kmem_cache instead hands
+   out objects of one exact size, carved out of page-sized "slabs".
+   Each slab starts with a header that holds a stack of the
+   indexes of its free objects; the objects follow it.
+
+   A cache keeps its slabs on three lists: partial slabs, which
+   have both free and allocated objects and satisfy allocations
+   first; full slabs, which have no free objects; and empty slabs,
+   at most SLAB_EMPTY_MAX of which are kept around to absorb
+   bursts before the rest go back to the page allocator.
+
+   If a cache has a constructor, it runs once per object when a
+   slab is created, not on every allocation, so users must return
+   objects to their constructed state before freeing them.  The
+   free stack lives in the slab header rather than in the free
+   objects for the same reason.
+
+   free() recognizes objects from a cache by their slab header and
+   hands them to kmem_free(), so code that must release memory
+   with free() may still allocate it from a cache. */
+
+/* Alignment of objects. */
+#define SLAB_ALIGN sizeof (void *)
+
+/* Number of empty slabs a cache keeps. */
+#define SLAB_EMPTY_MAX 1
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab0bce
+
+/* Slab header, at the start of each slab page. */
+struct slab {
+	unsigned magic;             /* Always set to SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* partial, full or empty list element. */
+	unsigned in_use;            /* Number of allocated objects. */
+	unsigned free_cnt;          /* Number of entries in free[]. */
+	uint8_t *objs;              /* First object. */
+	uint16_t free[];            /* Stack of free object indexes. */
+};
+
+/* Object cache. */
+struct kmem_cache {
+	const char *name;           /* Name (for debugging purposes). */
+	size_t obj_size;            /* Requested object size. */
+	size_t size;                /* Object size rounded up to SLAB_ALIGN. */
+	unsigned objs_per_slab;     /* Objects in one slab. */
+	size_t objs_ofs;            /* Offset of the first object in a slab. */
+	kmem_ctor *ctor;            /* Constructor, or null. */
+
+	struct lock lock;           /* Protects the members below. */
+	struct list partial;        /* Slabs with free and used objects. */
+	struct list full;           /* Slabs with no free objects. */
+	struct list empty;          /* Slabs with no used objects. */
+	size_t empty_cnt;           /* Number of slabs on `empty'. */
+	size_t slab_cnt;            /* Number of slabs. */
+	size_t in_use;              /* Number of allocated objects. */
+
+	struct list_elem elem;      /* `all_caches' element. */
+};
+
+/* List of all caches, for statistics. */
+static struct list all_caches;
+static struct lock all_caches_lock;
+
+static struct slab *slab_create (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Initializes the slab allocator. */
+void
+slab_init (void) {
+	list_init (&all_caches);
+	lock_init (&all_caches_lock);
+}
+
+/* Creates and returns a cache of objects of SIZE bytes, named
+   NAME, whose objects are initialized by CTOR if it is nonnull.
+   NAME must outlive the cache.  Panics if memory is not
+   available, since caches are created during initialization. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) {
+	struct kmem_cache *c;
+	size_t hdr;
+	unsigned n;
+
+	ASSERT (name != NULL);
+	ASSERT (size > 0);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		PANIC ("kmem_cache_create: out of memory");
+
+	c->name = name;
+	c->obj_size = size;
+	c->size = ROUND_UP (size, SLAB_ALIGN);
+	c->ctor = ctor;
+
+	/* Fit as many objects as possible, header included. */
+	for (n = PGSIZE / c->size; n > 0; n--) {
+		hdr = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t), SLAB_ALIGN);
+		if (hdr + n * c->size <= PGSIZE)
+			break;
+	}
+	if (n == 0)
+		PANIC ("kmem_cache_create: %s objects of %zu bytes do not fit in a page",
+				name, size);
+	c->objs_per_slab = n;
+	c->objs_ofs = hdr;
+
+	lock_init (&c->lock);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->empty_cnt = 0;
+	c->slab_cnt = 0;
+	c->in_use = 0;
+
+	lock_acquire (&all_caches_lock);
+	list_push_back (&all_caches, &c->elem);
+	lock_release (&all_caches_lock);
+	return c;
+}
+
+/* Allocates and returns an object from cache C, or a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	void *obj;
+
+	ASSERT (c != NULL);
+
+	lock_acquire (&c->lock);
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else if (!list_empty (&c->empty)) {
+		s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+		c->empty_cnt--;
+		list_push_front (&c->partial, &s->elem);
+	} else {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	ASSERT (s->free_cnt > 0);
+	obj = s->objs + c->size * s->free[--s->free_cnt];
+	s->in_use++;
+	c->in_use++;
+	if (s->free_cnt == 0) {
+		list_remove (&s->elem);
+		list_push_front (&c->full, &s->elem);
+	}
+	lock_release (&c->lock);
+	return obj;
+}
+
+/* Like kmem_cache_alloc(), but zeroes the object.  Only for
+   caches without a constructor. */
+void *
+kmem_cache_zalloc (struct kmem_cache *c) {
+	void *obj;
+
+	ASSERT (c->ctor == NULL);
+
+	obj = kmem_cache_alloc (c);
+	if (obj != NULL)
+		memset (obj, 0, c->obj_size);
+	return obj;
+}
+
+/* Returns OBJ, which must have been allocated from cache C, to
+   C.  A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s;
+
+	if (obj == NULL)
+		return;
+
+	s = obj_to_slab (c, obj);
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs.
+	   Constructed objects must keep their state. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->size);
+#endif
+
+	lock_acquire (&c->lock);
+	ASSERT (s->in_use > 0);
+	s->free[s->free_cnt++] = ((uint8_t *) obj - s->objs) / c->size;
+	s->in_use--;
+	c->in_use--;
+	if (s->in_use == 0) {
+		list_remove (&s->elem);
+		if (c->empty_cnt < SLAB_EMPTY_MAX) {
+			list_push_front (&c->empty, &s->elem);
+			c->empty_cnt++;
+		} else {
+			c->slab_cnt--;
+			palloc_free_page (s);
+		}
+	} else if (s->free_cnt == 1) {
+		/* Was full. */
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	lock_release (&c->lock);
+}
+
+/* Returns true if OBJ, which must have been allocated by malloc()
+   or from a cache, comes from a cache.  Slab pages carry no palloc
+   owner tag and start with SLAB_MAGIC, while the first page of a
+   malloc() arena or big block starts with a different magic. */
+bool
+kmem_owns (const void *obj) {
+	const struct slab *s = pg_round_down (obj);
+
+	return palloc_get_owner (obj) == NULL && s->magic == SLAB_MAGIC;
+}
+
+/* Returns OBJ, allocated from any cache, to its cache. */
+void
+kmem_free (void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	kmem_cache_free (s->cache, obj);
+}
+
+/* Returns the number of pages cache C occupies. */
+size_t
+kmem_cache_pages (const struct kmem_cache *c) {
+	return c->slab_cnt;
+}
+
+/* Prints statistics for every cache. */
+void
+kmem_cache_print_stats (void) {
+	struct list_elem *e;
+
+	lock_acquire (&all_caches_lock);
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		printf ("Slab: %s: %zu objects of %zu bytes in use, %zu pages, "
+				"%u objects per page\n", c->name, c->in_use, c->obj_size,
+				c->slab_cnt, c->objs_per_slab);
+	}
+	lock_release (&all_caches_lock);
+}
+
+/* Allocates a new slab for cache C and constructs its objects.
+   Returns a null pointer if memory is not available. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	unsigned i;
+
+	if (s == NULL)
+		return NULL;
+
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->in_use = 0;
+	s->free_cnt = c->objs_per_slab;
+	s->objs = (uint8_t *) s + c->objs_ofs;
+
+	/* Hand out low addresses first. */
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->free[i] = c->objs_per_slab - 1 - i;
+		if (c->ctor != NULL)
+			c->ctor (s->objs + c->size * i);
+	}
+	c->slab_cnt++;
+	return s;
+}
+
+/* Returns the slab that holds OBJ, checking that it belongs to
+   cache C. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+	ASSERT (((uint8_t *) obj - s->objs) % c->size == 0);
+	return s;
+}
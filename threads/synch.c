@@ -27,10 +27,16 @@
    */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#ifdef LOCK_PROFILE
+#include "devices/timer.h"
+#include "intrinsic.h"
+#endif
 
 //condition variable 우선순위 비교
 bool cmp_condvar_priority(const struct list_elem *a, const struct list_elem  *b, void *aux UNUSED);
@@ -117,10 +123,10 @@ sema_up (struct semaphore *sema) {
 
 	if (!list_empty (&sema->waiters))
 	{
-		list_sort(&sema->waiters, cmp_priority, NULL);
-		//sema->waiters에 있는 맨 앞 쓰레드를 깨운다.
-		thread_unblock (list_entry (list_pop_front (&sema->waiters),
-				struct thread, elem));			
+		//대기 중에 기부로 우선순위가 바뀌었을 수 있으므로 정렬 대신 가장 높은 우선순위 쓰레드를 찾아 깨운다.
+		struct list_elem *max_elem = list_min (&sema->waiters, cmp_priority, NULL);
+		list_remove (max_elem);
+		thread_unblock (list_entry (max_elem, struct thread, elem));
 	}
 
 	sema->value++;
@@ -183,12 +189,325 @@ sema_test_helper (void *sema_) {
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
    instead of a lock. */
+#ifndef LOCK_PROFILE
 void
 lock_init (struct lock *lock) {
+	lock_init_named (lock, NULL);
+}
+#endif
+
+/* Lock contention profiling.
+
+   Built only with -DLOCK_PROFILE (`make LOCK_PROFILE=1').  Locks
+   come and go with the objects that embed them, so statistics are
+   kept per lock_init() call site, which lock_init() passes in as
+   NAME, rather than per lock. */
+#ifdef LOCK_PROFILE
+#define LOCK_SITES_MAX 256
+
+static struct lock_site lock_sites[LOCK_SITES_MAX];
+static int lock_site_cnt;
+static struct lock_site lock_site_overflow = { "(other)", 0, 0, 0, 0, 0 };
+
+/* Returns the statistics record for call site NAME, creating it
+   if necessary. */
+static struct lock_site *
+lock_site_lookup (const char *name) {
+	enum intr_level old_level = intr_disable ();
+	struct lock_site *site = &lock_site_overflow;
+	int i;
+
+	for (i = 0; i < lock_site_cnt; i++)
+		if (lock_sites[i].name == name || !strcmp (lock_sites[i].name, name))
+			break;
+	if (i < lock_site_cnt)
+		site = &lock_sites[i];
+	else if (lock_site_cnt < LOCK_SITES_MAX) {
+		site = &lock_sites[lock_site_cnt++];
+		site->name = name;
+	}
+	intr_set_level (old_level);
+	return site;
+}
+
+/* Records that the current thread just took LOCK after waiting
+   WAIT_TICKS ticks, if CONTENDED.  Interrupts must be off. */
+static void
+lock_profile_acquired (struct lock *lock, bool contended, int64_t wait_ticks) {
+	struct lock_site *site = lock->site;
+
+	site->acquires++;
+	if (contended) {
+		site->contended++;
+		site->wait_ticks += wait_ticks;
+	}
+	lock->acquired_at = rdtsc ();
+}
+
+/* Records that the current thread is about to release LOCK.
+   Interrupts must be off. */
+static void
+lock_profile_released (struct lock *lock) {
+	struct lock_site *site = lock->site;
+	uint64_t hold = rdtsc () - lock->acquired_at;
+
+	if (hold > site->max_hold) {
+		site->max_hold = hold;
+		site->max_hold_tid = lock->holder->tid;
+	}
+}
+
+/* Returns the statistics for call site NAME, or a null pointer
+   if no lock was initialized there. */
+const struct lock_site *
+lock_profile_find (const char *name) {
+	const struct lock_site *site = NULL;
+	enum intr_level old_level = intr_disable ();
+
+	for (int i = 0; i < lock_site_cnt; i++)
+		if (!strcmp (lock_sites[i].name, name)) {
+			site = &lock_sites[i];
+			break;
+		}
+	intr_set_level (old_level);
+	return site;
+}
+
+/* Prints the TOP_N call sites with the most contended
+   acquisitions. */
+void
+lock_profile_print (int top_n) {
+	static bool printed[LOCK_SITES_MAX];
+	int i, n;
+
+	printf ("Locks: %d call sites, top %d by contention:\n",
+			lock_site_cnt, top_n);
+	memset (printed, 0, sizeof printed);
+	for (n = 0; n < top_n; n++) {
+		struct lock_site *best = NULL;
+		int best_idx = -1;
+
+		for (i = 0; i < lock_site_cnt; i++)
+			if (!printed[i] && (best == NULL
+						|| lock_sites[i].contended > best->contended)) {
+				best = &lock_sites[i];
+				best_idx = i;
+			}
+		if (best == NULL || best->acquires == 0)
+			break;
+		printed[best_idx] = true;
+		printf ("  %s: %"PRIu64" acquires, %"PRIu64" contended, "
+				"%"PRId64" wait ticks, max hold %"PRIu64" cycles (tid %d)\n",
+				best->name, best->acquires, best->contended,
+				best->wait_ticks, best->max_hold, best->max_hold_tid);
+	}
+}
+#endif /* LOCK_PROFILE */
+
+/* Initializes LOCK like lock_init(), calling it NAME for
+   debugging and profiling.  NAME may be a null pointer. */
+void
+lock_init_named (struct lock *lock, const char *name UNUSED) {
 	ASSERT (lock != NULL);
 
 	lock->holder = NULL;	//처음에는 어떤 스레드도 소유하지 X
 	sema_init (&lock->semaphore, 1);
+	lock->max_priority = -1;
+	lock->held_idx = -1;
+#ifdef LOCK_PROFILE
+	lock->site = name != NULL ? lock_site_lookup (name) : &lock_site_overflow;
+	lock->acquired_at = 0;
+#endif
+}
+
+/* Priority donation.
+
+   A waiter donates its priority to the holder of the lock it
+   waits for by raising the lock's max_priority.  The holder keeps
+   its locks in a max-heap on max_priority, so its effective
+   priority is always its own or that of held_locks[0].  Raising a
+   lock's max_priority and adding or removing a held lock are
+   O(log n) heap operations.  Locks held beyond the heap's
+   THREAD_HELD_LOCKS slots go on the held_extra list, which is
+   scanned linearly and refills the heap as locks are released.
+   A donation travels down a chain of
+   nested locks at most DONATION_DEPTH links. */
+#define DONATION_DEPTH 8
+
+/* Swaps the locks at heap positions I and J of T. */
+static void
+held_swap (struct thread *t, int i, int j) {
+	struct lock *tmp = t->held_locks[i];
+
+	t->held_locks[i] = t->held_locks[j];
+	t->held_locks[j] = tmp;
+	t->held_locks[i]->held_idx = i;
+	t->held_locks[j]->held_idx = j;
+}
+
+/* Moves the lock at heap position I of T up while it beats its
+   parent. */
+static void
+held_sift_up (struct thread *t, int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (t->held_locks[parent]->max_priority
+				>= t->held_locks[i]->max_priority)
+			break;
+		held_swap (t, i, parent);
+		i = parent;
+	}
+}
+
+/* Moves the lock at heap position I of T down while one of its
+   children beats it. */
+static void
+held_sift_down (struct thread *t, int i) {
+	for (;;) {
+		int max = i;
+		int left = 2 * i + 1;
+		int right = left + 1;
+
+		if (left < t->held_cnt && t->held_locks[left]->max_priority
+				> t->held_locks[max]->max_priority)
+			max = left;
+		if (right < t->held_cnt && t->held_locks[right]->max_priority
+				> t->held_locks[max]->max_priority)
+			max = right;
+		if (max == i)
+			break;
+		held_swap (t, i, max);
+		i = max;
+	}
+}
+
+/* Returns the lock on T's held_extra list with the highest
+   max_priority, or a null pointer if the list is empty. */
+static struct lock *
+held_extra_max (struct thread *t) {
+	struct lock *max = NULL;
+	struct list_elem *e;
+
+	for (e = list_begin (&t->held_extra); e != list_end (&t->held_extra);
+			e = list_next (e)) {
+		struct lock *lock = list_entry (e, struct lock, held_elem);
+		if (max == NULL || lock->max_priority > max->max_priority)
+			max = lock;
+	}
+	return max;
+}
+
+/* Adds LOCK to the locks held by T: to the heap, or to held_extra
+   if the heap is full. */
+static void
+held_push (struct thread *t, struct lock *lock) {
+	if (t->held_cnt == THREAD_HELD_LOCKS) {
+		lock->held_idx = LOCK_HELD_EXTRA;
+		list_push_back (&t->held_extra, &lock->held_elem);
+		return;
+	}
+
+	lock->held_idx = t->held_cnt++;
+	t->held_locks[lock->held_idx] = lock;
+	held_sift_up (t, lock->held_idx);
+}
+
+/* Removes LOCK from the locks held by T.  A slot freed in the heap
+   goes to the best lock on held_extra. */
+static void
+held_remove (struct thread *t, struct lock *lock) {
+	int i = lock->held_idx;
+	int last;
+	struct lock *extra;
+
+	if (i == LOCK_HELD_EXTRA) {
+		list_remove (&lock->held_elem);
+		lock->held_idx = -1;
+		return;
+	}
+
+	ASSERT (t->held_locks[i] == lock);
+
+	last = --t->held_cnt;
+	if (i != last) {
+		held_swap (t, i, last);
+		held_sift_down (t, i);
+		held_sift_up (t, i);
+	}
+	lock->held_idx = -1;
+
+	extra = held_extra_max (t);
+	if (extra != NULL) {
+		list_remove (&extra->held_elem);
+		held_push (t, extra);
+	}
+}
+
+/* Returns the highest max_priority among the locks T holds, that
+   is, the best priority donated to T, or -1 if it holds none. */
+int
+lock_held_max_priority (struct thread *t) {
+	int max = t->held_cnt > 0 ? t->held_locks[0]->max_priority : -1;
+
+	if (!list_empty (&t->held_extra)) {
+		struct lock *extra = held_extra_max (t);
+		if (extra->max_priority > max)
+			max = extra->max_priority;
+	}
+	return max;
+}
+
+/* Returns the highest priority among the threads waiting for
+   LOCK, or -1 if there are none. */
+static int
+lock_waiters_max (struct lock *lock) {
+	struct list *waiters = &lock->semaphore.waiters;
+	struct list_elem *e;
+	int max = -1;
+
+	for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e)) {
+		struct thread *t = list_entry (e, struct thread, elem);
+		if (t->priority > max)
+			max = t->priority;
+	}
+	return max;
+}
+
+/* Donates PRIORITY through LOCK to its holder, and on down the
+   chain of locks the holders are themselves waiting for.
+   Interrupts must be off. */
+static void
+donate_priority (struct lock *lock, int priority) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (int depth = 0; depth < DONATION_DEPTH && lock != NULL; depth++) {
+		struct thread *holder = lock->holder;
+
+		if (holder == NULL || lock->max_priority >= priority)
+			break;
+		lock->max_priority = priority;
+		if (lock->held_idx != LOCK_HELD_EXTRA)
+			held_sift_up (holder, lock->held_idx);
+
+		if (holder->priority >= priority)
+			break;
+		thread_refresh_priority (holder);
+		lock = holder->wait_on_lock;
+	}
+}
+
+/* Makes the current thread the holder of LOCK, whose semaphore
+   it has just downed.  Interrupts must be off. */
+static void
+lock_take (struct lock *lock) {
+	struct thread *curr = thread_current ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	lock->holder = curr;
+	lock->max_priority = lock_waiters_max (lock);
+	held_push (curr, lock);
+	thread_refresh_priority (curr);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -201,42 +520,38 @@ lock_init (struct lock *lock) {
    we need to sleep. */
 void
 lock_acquire (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+#ifdef LOCK_PROFILE
+	bool contended;
+	int64_t wait_start = timer_ticks ();
+#endif
+
 	ASSERT (lock != NULL);
 	ASSERT (!intr_context ());
 	ASSERT (!lock_held_by_current_thread (lock));
 
-	if(lock->holder != NULL)
-	{
-		//wait_on_lock에 lock을 저장한다.
-        thread_current()->wait_on_lock = lock;
-        
-		//lock holder의 priority가 더 작으면 나의 priority를 기부
-        if(lock->holder->priority < thread_current()->priority)
-        {
-            //donoation list에 insert
-            list_insert_ordered(&lock->holder->donations, &thread_current()->d_elem, cmp_donor_priority, NULL);
-
-		}
-
-		struct lock *cur_wait_on_lock = thread_current()->wait_on_lock;
-		while(cur_wait_on_lock  != NULL)
-		{
-			if(cur_wait_on_lock->holder->priority< thread_current()->priority)
-			{
-				cur_wait_on_lock->holder->priority = thread_current()->priority;
-				cur_wait_on_lock = cur_wait_on_lock->holder->wait_on_lock;
-
-			}
-			else
-				break;
-		}
+	old_level = intr_disable ();
+#ifdef LOCK_PROFILE
+	contended = lock->semaphore.value == 0;
+#endif
+	if (lock->holder != NULL) {
+		//wait_on_lock에 lock을 저장하고, 락 소유자에게 우선순위를 기부한다.
+		//(MLFQS에서는 기부하지 않는다.)
+		curr->wait_on_lock = lock;
+		if (!thread_mlfqs)
+			donate_priority (lock, curr->priority);
 	}
 
 	sema_down (&lock->semaphore);
 
 	//락 획득 -> 현재 쓰레드의 wait_on_lock NULL로 설정
-	thread_current()->wait_on_lock = NULL;
-	lock->holder = thread_current ();	//현재 스레드에 대한 잠금 획득
+	curr->wait_on_lock = NULL;
+	lock_take (lock);	//현재 스레드에 대한 잠금 획득
+#ifdef LOCK_PROFILE
+	lock_profile_acquired (lock, contended, timer_ticks () - wait_start);
+#endif
+	intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -247,14 +562,21 @@ lock_acquire (struct lock *lock) {
    interrupt handler. */
 bool
 lock_try_acquire (struct lock *lock) {
+	enum intr_level old_level;
 	bool success;
 
 	ASSERT (lock != NULL);
 	ASSERT (!lock_held_by_current_thread (lock));
 
+	old_level = intr_disable ();
 	success = sema_try_down (&lock->semaphore);
-	if (success)
-		lock->holder = thread_current ();
+	if (success) {
+		lock_take (lock);
+#ifdef LOCK_PROFILE
+		lock_profile_acquired (lock, false, 0);
+#endif
+	}
+	intr_set_level (old_level);
 	return success;
 }
 
@@ -266,40 +588,23 @@ lock_try_acquire (struct lock *lock) {
    handler. */
 void
 lock_release (struct lock *lock) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
 	ASSERT (lock != NULL);
 	ASSERT (lock_held_by_current_thread (lock));
 
-	if(!list_empty(&lock->holder->donations))
-	{	
-		//탐색을 위한 현재 donations 리스트에서 맨 앞 요소 확인
-		struct list_elem *front_elem = list_begin(&lock->holder->donations);
-
-		//리스트 탐색
-		while(front_elem != list_end(&lock->holder->donations))
-		{
-			struct thread *front_thread = list_entry(front_elem, struct thread, d_elem);
-			
-			//해당 락 소유 쓰레드 찾기
-			if(front_thread->wait_on_lock == lock)
-			{
-				list_remove(&front_thread->d_elem);
-				front_thread->wait_on_lock = NULL;
-			}			
-			front_elem = list_next(front_elem);
-		}
-
-		//donations list가 비어있지 않다면 list에 있는 가장 큰 우선순위로 락 소유 스레드에게 기부 한다.
-		if(!list_empty(&lock->holder->donations))
-		{
-			struct thread *next_thread = list_entry(list_front(&lock->holder->donations), struct thread, d_elem);
-			lock->holder->priority = next_thread->priority;
-		}	
-		//비어있으면 원래의 우선순위로 복귀
-		else
-			lock->holder->priority = lock->holder->original_priority;
-	}
-
+	//이 락을 통해 받은 기부를 거둬들인다.
+	old_level = intr_disable ();
+#ifdef LOCK_PROFILE
+	lock_profile_released (lock);
+#endif
+	held_remove (curr, lock);
+	lock->max_priority = -1;
 	lock->holder = NULL;
+	thread_refresh_priority (curr);
+	intr_set_level (old_level);
+
 	sema_up (&lock->semaphore);
 }
 
@@ -407,6 +712,237 @@ cond_broadcast (struct condition *cond, struct lock *lock) {
 		cond_signal (cond, lock);
 }
 
+/* Initializes readers-writer lock RW.  Any number of readers
+   may hold RW at once, or a single writer.
+
+   RW is writer-preferring: a writer takes RW's internal lock
+   first and then waits for the current readers to drain, so
+   readers that arrive later queue up behind it on that same lock.
+   Because the writer holds a regular lock, waiting readers and
+   writers donate their priority to it.  Readers do not receive
+   donations.  A thread that already holds RW for reading must not
+   try to read-acquire it again, or it may deadlock with a waiting
+   writer. */
+void
+rwlock_init (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	lock_init (&rw->lock);
+	rw->readers = 0;
+	rw->writer_waiting = false;
+	sema_init (&rw->drained, 0);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   waits for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_read_acquire (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	rw->readers++;
+	lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false if a writer holds or waits for RW. */
+bool
+rwlock_read_try_acquire (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	if (!lock_try_acquire (&rw->lock))
+		return false;
+	rw->readers++;
+	lock_release (&rw->lock);
+	return true;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_read_release (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+
+	old_level = intr_disable ();
+	ASSERT (rw->readers > 0);
+	if (--rw->readers == 0 && rw->writer_waiting) {
+		rw->writer_waiting = false;
+		sema_up (&rw->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other writer or
+   reader holds it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_write_acquire (struct rwlock *rw) {
+	enum intr_level old_level;
+
+	ASSERT (rw != NULL);
+	ASSERT (!intr_context ());
+
+	lock_acquire (&rw->lock);
+	old_level = intr_disable ();
+	while (rw->readers > 0) {
+		rw->writer_waiting = true;
+		sema_down (&rw->drained);
+	}
+	intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false if anyone else holds RW. */
+bool
+rwlock_write_try_acquire (struct rwlock *rw) {
+	enum intr_level old_level;
+	bool success;
+
+	ASSERT (rw != NULL);
+
+	if (!lock_try_acquire (&rw->lock))
+		return false;
+	old_level = intr_disable ();
+	success = rw->readers == 0;
+	intr_set_level (old_level);
+	if (!success)
+		lock_release (&rw->lock);
+	return success;
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_write_release (struct rwlock *rw) {
+	ASSERT (rw != NULL);
+	ASSERT (rwlock_write_held_by_current_thread (rw));
+
+	lock_release (&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw) {
+	ASSERT (rw != NULL);
+
+	return lock_held_by_current_thread (&rw->lock) && rw->readers == 0;
+}
+
+/* Initializes sequence lock SL. */
+void
+seqlock_init (struct seqlock *sl) {
+	ASSERT (sl != NULL);
+
+	sl->seq = 0;
+	spin_lock_init (&sl->lock, "seqlock");
+}
+
+/* Starts a read of the data protected by SL, returning the
+   sequence number to pass to seqlock_read_retry(). */
+unsigned
+seqlock_read_begin (const struct seqlock *sl) {
+	unsigned seq;
+
+	while ((seq = sl->seq) & 1)
+		asm volatile ("pause");
+	barrier ();
+	return seq;
+}
+
+/* Returns true if the data protected by SL changed since
+   seqlock_read_begin() returned SEQ, so the read must be
+   repeated. */
+bool
+seqlock_read_retry (const struct seqlock *sl, unsigned seq) {
+	barrier ();
+	return sl->seq != seq;
+}
+
+/* Starts a write of the data protected by SL.  Interrupts must
+   be off. */
+void
+seqlock_write_begin (struct seqlock *sl) {
+	spin_lock (&sl->lock);
+	sl->seq++;
+	barrier ();
+}
+
+/* Ends a write of the data protected by SL. */
+void
+seqlock_write_end (struct seqlock *sl) {
+	barrier ();
+	sl->seq++;
+	spin_unlock (&sl->lock);
+}
+
+/* Initializes spinlock SL, which is named NAME for debugging. */
+void
+spin_lock_init (struct spinlock *sl, const char *name) {
+	ASSERT (sl != NULL);
+
+	sl->locked = 0;
+	sl->name = name;
+	sl->cpu = NULL;
+}
+
+/* Acquires spinlock SL, busy-waiting until it is available.
+   Interrupts must be off and SL must not already be held by this
+   CPU. */
+void
+spin_lock (struct spinlock *sl) {
+	ASSERT (sl != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (!spin_lock_held (sl));
+
+	/* xchg is atomic and a full memory barrier.  While the lock
+	   is busy, spin on plain reads so the cache line is not
+	   bounced between CPUs. */
+	while (__atomic_exchange_n (&sl->locked, 1, __ATOMIC_ACQUIRE) != 0)
+		while (sl->locked != 0)
+			asm volatile ("pause");
+	sl->cpu = cpu_current ();
+}
+
+/* Releases spinlock SL, which must be held by this CPU. */
+void
+spin_unlock (struct spinlock *sl) {
+	ASSERT (sl != NULL);
+	ASSERT (spin_lock_held (sl));
+
+	sl->cpu = NULL;
+	__atomic_store_n (&sl->locked, 0, __ATOMIC_RELEASE);
+}
+
+/* Disables interrupts, acquires SL and returns the previous
+   interrupt level, to be passed to spin_unlock_irqrestore(). */
+enum intr_level
+spin_lock_irqsave (struct spinlock *sl) {
+	enum intr_level old_level = intr_disable ();
+	spin_lock (sl);
+	return old_level;
+}
+
+/* Releases SL and restores the interrupt level OLD_LEVEL. */
+void
+spin_unlock_irqrestore (struct spinlock *sl, enum intr_level old_level) {
+	spin_unlock (sl);
+	intr_set_level (old_level);
+}
+
+/* Returns true if this CPU holds SL, false otherwise. */
+bool
+spin_lock_held (const struct spinlock *sl) {
+	ASSERT (sl != NULL);
+
+	return sl->locked != 0 && sl->cpu == cpu_current ();
+}
+
 //condition variable 우선순위 비교
 bool
 cmp_condvar_priority(const struct list_elem *a, const struct list_elem  *b, void *aux UNUSED) {
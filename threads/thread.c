@@ -4,12 +4,15 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/memtrack.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #include <list.h>
 #ifdef USERPROG
@@ -25,17 +28,25 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* sleep list */
-static struct list sleep_list;
-/* prioirty list */
-static struct list greater_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+/* Run queue of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   Each CPU has its own.  There is one FIFO list per priority
+   level.  Bit (PRI_MAX - P) of `mask' is set iff queues[P] is
+   nonempty, so the highest runnable priority is found with a
+   single bsf.  Threads with an EDF reservation are kept apart,
+   ordered by deadline, and always run first. */
+struct runqueue {
+	struct spinlock lock;           /* Protects the members below. */
+	struct list edf;                /* EDF threads, earliest deadline first. */
+	struct list queues[PRI_MAX + 1];
+	uint64_t mask;
+	int cnt;                        /* # of threads in the run queue. */
+};
+static struct runqueue runqueues[NCPU_MAX];
+
+/* Per-CPU state.  Only the bootstrap processor runs (see
+   cpu.h). */
+struct cpu cpus[NCPU_MAX];
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -46,24 +57,73 @@ static struct lock tid_lock;
 /* Thread destruction requests */
 static struct list destruction_req;
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-
 /* Scheduling. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
-bool sleep_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
+
+/* Multi-level feedback queue scheduler.
+
+   recent_cpu of every thread decays once per second by a factor
+   that depends on load_avg.  Each decay factor is appended to
+   decay_history and counted in mlfqs_epoch.  A thread remembers
+   how many decays it has seen and applies the missing ones when
+   it is next looked at.  The running thread and the ready threads
+   are brought up to date at every decay, and ready threads whose
+   priority changed move to the queue for their new priority
+   (mlfqs_update_ready()), as in 4.4BSD.  Blocked threads, which
+   may be many, are brought up to date when they are unblocked.
+   Between decays only the running thread's recent_cpu changes,
+   so only its priority is recomputed every fourth tick.
+
+   A decay factor is overwritten DECAY_HISTORY seconds after it
+   was recorded.  To keep every thread within reach of the
+   history, threads are kept in mlfqs_stale by their mlfqs_epoch
+   modulo DECAY_HISTORY, and each second the threads that have
+   not been looked at for DECAY_HISTORY seconds are brought up to
+   date.  Each thread is visited this way at most once every
+   DECAY_HISTORY seconds. */
+#define DECAY_HISTORY 128
+static fixed_t load_avg;
+static fixed_t decay_history[DECAY_HISTORY];
+static unsigned mlfqs_epoch;    /* # of recent_cpu decays so far. */
+static struct list mlfqs_stale[DECAY_HISTORY];
+
+/* Earliest-deadline-first scheduling class.
+
+   A thread may reserve RUNTIME ticks of CPU time every PERIOD
+   ticks.  While it has budget left it runs ahead of every thread
+   in the priority class, and EDF threads among themselves run in
+   order of their current deadline (the end of their period).
+   thread_tick() charges the budget; a thread that runs out is
+   throttled until its next period starts.  A reservation is only
+   admitted if the sum of RUNTIME / PERIOD over all reservations
+   stays within thread_edf_bound percent, which, together with
+   budget enforcement, guarantees every deadline on one CPU. */
+int thread_edf_bound = 90;
+static fixed_t edf_util;        /* Total utilisation of all reservations. */
+static struct spinlock edf_lock;        /* Protects edf_util. */
 bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void runq_push (struct thread *);
+static void runq_insert (struct runqueue *, struct thread *);
+static struct thread *runq_pop (struct runqueue *);
+static int runq_max_priority (void);
+static int runq_ready_cnt (void);
+static bool edf_deadline_less (const struct list_elem *,
+		const struct list_elem *, void *aux);
+static void edf_new_period (struct thread *, int64_t now);
+static timer_event_func edf_replenish;
+static void edf_cancel (struct thread *);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_catch_up (struct thread *);
+static void mlfqs_update_ready (void);
+static int mlfqs_priority (const struct thread *);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static void do_schedule(int status);
@@ -118,9 +178,23 @@ thread_init (void) {
 
 	/* Init the globla thread context */
 	lock_init (&tid_lock);
-	list_init (&ready_list);
-	list_init (&sleep_list);
-	list_init (&greater_list);
+	for (unsigned i = 0; i < NCPU_MAX; i++) {
+		struct runqueue *rq = &runqueues[i];
+
+		cpus[i].id = i;
+		spin_lock_init (&rq->lock, "runqueue");
+		list_init (&rq->edf);
+		for (int pri = PRI_MIN; pri <= PRI_MAX; pri++)
+			list_init (&rq->queues[pri]);
+		rq->mask = 0;
+		rq->cnt = 0;
+	}
+	load_avg = 0;
+	mlfqs_epoch = 0;
+	for (int i = 0; i < DECAY_HISTORY; i++)
+		list_init (&mlfqs_stale[i]);
+	spin_lock_init (&edf_lock, "edf");
+	edf_util = 0;
 	list_init (&destruction_req);
 
 	/* Set up a thread structure for the running thread. */
@@ -128,6 +202,8 @@ thread_init (void) {
 	init_thread (initial_thread, "main", PRI_DEFAULT);
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid ();
+	if (thread_mlfqs)
+		list_push_back (&mlfqs_stale[0], &initial_thread->mlfqs_elem);
 }
 
 /* 스케줄러를 시작하기 위해 호출.
@@ -151,27 +227,47 @@ thread_start (void) {
 void
 thread_tick (void) {
 	struct thread *t = thread_current ();
+	struct cpu *c = cpu_current ();
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;	//시스템이 얼마나 자유롭게 idle 상태에 있었는지 
+	if (t == c->idle_thread)
+		c->idle_ticks++;	//시스템이 얼마나 자유롭게 idle 상태에 있었는지 
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
-		user_ticks++;
+		c->user_ticks++;
 #endif
 	else
-		kernel_ticks++;	//시스템이 커널 내에서 작업을 수행한 시간 , 시스템의 성능 분석이나 디버깅에 유용
+		c->kernel_ticks++;	//시스템이 커널 내에서 작업을 수행한 시간 , 시스템의 성능 분석이나 디버깅에 유용
+
+	if (thread_mlfqs)
+		mlfqs_tick (t);
+
+	/* Charge EDF budget.  Out of budget: stop running until the
+	   next period, see thread_yield(). */
+	if (t->edf_period != 0 && --t->edf_budget <= 0) {
+		t->edf_throttled = true;
+		intr_yield_on_return ();
+	}
 
 	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)	//스레드가 실행되는 시간이 time slice보다 길어지면 
+	if (++c->thread_ticks >= TIME_SLICE)	//스레드가 실행되는 시간이 time slice보다 길어지면 
 		intr_yield_on_return ();	//다음 인터럽트 처리 과정에서 스케줄링 이루어지도록 함
 }
 
 /* 핀토스 종료 시 호출되어 스레드 통계를 출력한다. */
 void
 thread_print_stats (void) {
+	long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+
+	for (unsigned i = 0; i < NCPU_MAX; i++) {
+		idle_ticks += cpus[i].idle_ticks;
+		kernel_ticks += cpus[i].kernel_ticks;
+		user_ticks += cpus[i].user_ticks;
+	}
 	printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 			idle_ticks, kernel_ticks, user_ticks);
+	printf ("Thread: %lld idle ticks skipped by tickless idle\n",
+			(long long) timer_skipped_ticks ());
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -206,6 +302,22 @@ thread_create (const char *name, int priority,
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
 
+	/* Under the MLFQS a new thread inherits the creator's nice
+	   and recent_cpu, and PRIORITY is ignored. */
+	if (thread_mlfqs) {
+		struct thread *curr = thread_current ();
+		enum intr_level old_level = intr_disable ();
+
+		mlfqs_catch_up (curr);
+		t->nice = curr->nice;
+		t->recent_cpu = curr->recent_cpu;
+		t->mlfqs_epoch = mlfqs_epoch;
+		t->priority = mlfqs_priority (t);
+		list_push_back (&mlfqs_stale[mlfqs_epoch % DECAY_HISTORY],
+				&t->mlfqs_elem);
+		intr_set_level (old_level);
+	}
+
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
 	t->tf.rip = (uintptr_t) kernel_thread;
@@ -263,10 +375,14 @@ thread_unblock (struct thread *t) {
 	old_level = intr_disable ();
 	ASSERT (t->status == THREAD_BLOCKED);
 
-	//우선순위로 정렬하여 ready_list에 삽입
-	list_insert_ordered(&ready_list, &t->elem, cmp_priority, NULL);
+	/* Bring recent_cpu up to date after sleeping. */
+	if (thread_mlfqs) {
+		mlfqs_catch_up (t);
+		t->priority = mlfqs_priority (t);
+	}
 
-	// list_push_back (&ready_list, &t->elem);
+	//우선순위에 해당하는 run queue에 삽입
+	runq_push (t);
 	t->status = THREAD_READY;
 	intr_set_level (old_level);
 }
@@ -310,11 +426,19 @@ thread_exit (void) {
 #ifdef USERPROG
 	process_exit ();
 #endif
+#ifdef MEMTRACK
+	memtrack_thread_exit (thread_current ()->tid);
+#endif
+
+	if (thread_current ()->edf_period != 0)
+		edf_cancel (thread_current ());
 
 	/* Just set our status to dying and schedule another process.
 	   We will be destroyed during the call to schedule_tail(). */
 
 	intr_disable ();			//현재 인터럽트 비활성화 -> 유저 모드로 전환
+	if (thread_mlfqs)
+		list_remove (&thread_current ()->mlfqs_elem);
 	do_schedule (THREAD_DYING);	//스레드 스케줄러에 스레드의 종료 상태를 알려줌
 	NOT_REACHED ();
 }
@@ -332,84 +456,76 @@ thread_yield (void) {
 	ASSERT (!intr_context ());
 
 	old_level = intr_disable (); //인터럽트 비활성화, 유저 모드-> 커널 모드
-	if (curr != idle_thread)
-		list_insert_ordered(&ready_list, &curr->elem, cmp_priority, NULL);
-
-	do_schedule (THREAD_READY);	//contenxt switching
+	if (curr->edf_throttled) {
+		/* Out of EDF budget: sleep until the next period. */
+		timer_event_add (&curr->edf_timer, curr->edf_deadline);
+		do_schedule (THREAD_BLOCKED);
+	} else {
+		if (curr != cpu_current ()->idle_thread)
+			runq_push (curr);
+
+		do_schedule (THREAD_READY);	//contenxt switching
+	}
 	intr_set_level (old_level);	// 인터럽트 활성화, 커널 모드-> 유저 모드
 }
 
 void thread_try_yield(void){
-	if(!list_empty(&ready_list) && thread_current() != idle_thread && !(intr_context()))
+	if(runq_max_priority() >= 0 && thread_current() != cpu_current ()->idle_thread && !(intr_context()))
 		thread_yield();
 }
 
+/* Sets the current thread's priority to NEW_PRIORITY.
+	현재 스레드의 우선순위를 새 우선순위로 설정 , 현재 스레드가 더 이상 가장 높은 우선 순위를 갖지 않으면 yield*/
 void
-thread_sleep(int64_t ticks){
-	struct thread *curr = thread_current();
-	enum intr_level old_level;	
+thread_set_priority (int new_priority) {
+	/* The MLFQS sets priorities itself. */
+	if (thread_mlfqs)
+		return;
 
-	ASSERT(!intr_context());
+	//기부받은 우선순위가 더 높으면 그대로 유지된다.
+	thread_current ()->original_priority = new_priority;
+	thread_refresh_priority (thread_current ());
+
+	if(thread_current()->priority < runq_max_priority())
+		thread_yield(); 
 
-	old_level = intr_disable();
-	curr->status = THREAD_BLOCKED;
-	curr->wakeup_tick = ticks;
-	
-	if(curr!= idle_thread)
-		list_insert_ordered(&sleep_list, &curr->elem, sleep_less , NULL);	//오름차순으로 정렬
-	schedule();
-	intr_set_level(old_level);
 }
 
+/* Recomputes T's priority as the higher of its own and the best
+   donation through the locks it holds, moving T to its new run
+   queue if it is ready.  Does nothing under the MLFQS. */
 void
-thread_wakeup(int64_t ticks)
-{
-	if(list_empty(&sleep_list))
-		return;
-
+thread_refresh_priority (struct thread *t) {
 	enum intr_level old_level;
-	
-	//sleep_list의 시작 지점에 대한 iterator를 반환하여 해당 요소를 struct thread로 캐스팅
-	struct thread *sleep_front_thread = list_entry(list_begin(&sleep_list),struct thread, elem);
-	struct thread *sleep_pop_front_thread;
-
-	//깨어야하는 애들 중에서 우선순위가 높은 스레드를 greater_list에 삽입
-	while(sleep_front_thread->wakeup_tick <= ticks)
-	{
-		old_level = intr_disable();
-		sleep_front_thread->status = THREAD_READY;
-		
-		/* alarm clock - priority */
-		sleep_pop_front_thread = list_entry(list_pop_front(&sleep_list), struct thread, elem);
-		list_insert_ordered(&greater_list, &sleep_pop_front_thread->elem , cmp_priority, NULL);
-		
-		sleep_front_thread = list_entry(list_begin(&sleep_list),struct thread, elem);	
-		intr_set_level(old_level);
-	}
-
-	while(!list_empty(&greater_list))
-	{
-		old_level = intr_disable();
-		list_push_back(&ready_list, list_pop_front(&greater_list));
-		intr_set_level(old_level);
-	}
-}
+	int priority, donated;
 
-/* Sets the current thread's priority to NEW_PRIORITY.
-	현재 스레드의 우선순위를 새 우선순위로 설정 , 현재 스레드가 더 이상 가장 높은 우선 순위를 갖지 않으면 yield*/
-void
-thread_set_priority (int new_priority) {
-	if(list_empty(&thread_current()->donations))
-	{
-		thread_current ()->priority = new_priority;
-	}
-	//만약 donations list가 비어있지 않다면
-	thread_current ()->original_priority = new_priority;
+	ASSERT (is_thread (t));
 
-	struct thread *head_thread = list_entry(list_begin(&ready_list), struct thread, elem);
-	if(thread_current()->priority < head_thread->priority)	
-		thread_yield(); 
+	if (thread_mlfqs)
+		return;
 
+	old_level = intr_disable ();
+	priority = t->original_priority;
+	donated = lock_held_max_priority (t);
+	if (donated > priority)
+		priority = donated;
+
+	if (priority != t->priority) {
+		if (t->status == THREAD_READY && t->edf_period == 0) {
+			struct runqueue *rq = &runqueues[t->runq];
+
+			spin_lock (&rq->lock);
+			list_remove (&t->elem);
+			if (list_empty (&rq->queues[t->priority]))
+				rq->mask &= ~(1ULL << (PRI_MAX - t->priority));
+			rq->cnt--;
+			t->priority = priority;
+			runq_insert (rq, t);
+			spin_unlock (&rq->lock);
+		} else
+			t->priority = priority;
+	}
+	intr_set_level (old_level);
 }
 
 /* Returns the current thread's priority.     
@@ -419,31 +535,308 @@ thread_get_priority (void) {
 	return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it is no longer the highest. */
 void
-thread_set_nice (int nice UNUSED) {
-	/* TODO: Your implementation goes here */
+thread_set_nice (int nice) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+
+	ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+	old_level = intr_disable ();
+	curr->nice = nice;
+	if (thread_mlfqs) {
+		mlfqs_catch_up (curr);
+		curr->priority = mlfqs_priority (curr);
+	}
+	intr_set_level (old_level);
+
+	if (curr->priority < runq_max_priority ())
+		thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	enum intr_level old_level = intr_disable ();
+	int load_avg_100 = fp_round (fp_mul_int (load_avg, 100));
+	intr_set_level (old_level);
+	return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) {
-	/* TODO: Your implementation goes here */
-	return 0;
+	struct thread *curr = thread_current ();
+	enum intr_level old_level = intr_disable ();
+	int recent_cpu_100;
+
+	mlfqs_catch_up (curr);
+	recent_cpu_100 = fp_round (fp_mul_int (curr->recent_cpu, 100));
+	intr_set_level (old_level);
+	return recent_cpu_100;
+}
+
+/* Moves the running thread into the EDF class with a
+   reservation of RUNTIME ticks every PERIOD ticks, starting a
+   period now.  Returns false, leaving the thread as it was, if
+   admitting the reservation would push the total utilisation
+   above thread_edf_bound percent. */
+bool
+thread_edf_reserve (int64_t runtime, int64_t period) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	fixed_t util;
+
+	ASSERT (0 < runtime && runtime <= period);
+	ASSERT (curr->edf_period == 0);
+
+	util = fp_div (fp_from_int (runtime), fp_from_int (period));
+	old_level = spin_lock_irqsave (&edf_lock);
+	if (edf_util + util > fp_div_int (fp_from_int (thread_edf_bound), 100)) {
+		spin_unlock_irqrestore (&edf_lock, old_level);
+		return false;
+	}
+	edf_util += util;
+	spin_unlock (&edf_lock);
+
+	curr->edf_runtime = runtime;
+	curr->edf_period = period;
+	curr->edf_deadline = timer_ticks () + period;
+	curr->edf_job_deadline = curr->edf_deadline;
+	curr->edf_budget = runtime;
+	curr->edf_throttled = false;
+	curr->edf_missed = 0;
+	curr->edf_max_lateness = 0;
+	timer_event_init (&curr->edf_timer, edf_replenish, curr);
+	intr_set_level (old_level);
+
+	/* Let an EDF thread with an earlier deadline go first. */
+	thread_yield ();
+	return true;
+}
+
+/* Returns the running thread from the EDF class to the priority
+   class and releases its reservation. */
+void
+thread_edf_cancel (void) {
+	ASSERT (thread_current ()->edf_period != 0);
+
+	edf_cancel (thread_current ());
+	thread_try_yield ();
+}
+
+/* Ends the running EDF thread's current job.  Records whether it
+   met its deadline, then sleeps until the next period begins
+   with a fresh budget. */
+void
+thread_edf_wait_period (void) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	int64_t now;
+
+	ASSERT (curr->edf_period != 0);
+
+	old_level = intr_disable ();
+	now = timer_ticks ();
+	if (now > curr->edf_job_deadline) {
+		int64_t lateness = now - curr->edf_job_deadline;
+
+		curr->edf_missed++;
+		if (lateness > curr->edf_max_lateness)
+			curr->edf_max_lateness = lateness;
+	}
+
+	if (now < curr->edf_deadline) {
+		timer_event_add (&curr->edf_timer, curr->edf_deadline);
+		thread_block ();
+	} else
+		edf_new_period (curr, now);
+	curr->edf_job_deadline = curr->edf_deadline;
+	intr_set_level (old_level);
+}
+
+/* Starts the next period of EDF thread T, skipping any that
+   already ended before NOW, and refills its budget. */
+static void
+edf_new_period (struct thread *t, int64_t now) {
+	do
+		t->edf_deadline += t->edf_period;
+	while (t->edf_deadline <= now);
+	t->edf_budget = t->edf_runtime;
+	t->edf_throttled = false;
+}
+
+/* Timer callback that starts a new period for EDF thread T_,
+   which is blocked waiting for it. */
+static void
+edf_replenish (void *t_) {
+	struct thread *t = t_;
+	struct thread *curr = thread_current ();
+
+	edf_new_period (t, timer_ticks ());
+	thread_unblock (t);
+
+	if (curr == cpu_current ()->idle_thread || curr->edf_period == 0
+			|| t->edf_deadline < curr->edf_deadline)
+		intr_yield_on_return ();
+}
+
+/* Releases EDF thread T's reservation. */
+static void
+edf_cancel (struct thread *t) {
+	enum intr_level old_level;
+
+	timer_event_cancel (&t->edf_timer);
+	old_level = spin_lock_irqsave (&edf_lock);
+	edf_util -= fp_div (fp_from_int (t->edf_runtime),
+			fp_from_int (t->edf_period));
+	t->edf_period = 0;
+	t->edf_throttled = false;
+	spin_unlock_irqrestore (&edf_lock, old_level);
+}
+
+/* Returns true if EDF thread A's deadline is earlier than B's. */
+static bool
+edf_deadline_less (const struct list_elem *a_, const struct list_elem *b_,
+		void *aux UNUSED) {
+	const struct thread *a = list_entry (a_, struct thread, elem);
+	const struct thread *b = list_entry (b_, struct thread, elem);
+
+	return a->edf_deadline < b->edf_deadline;
+}
+
+/* Per-tick MLFQS bookkeeping for the running thread T.  Runs in
+   the timer interrupt and takes constant time. */
+static void
+mlfqs_tick (struct thread *t) {
+	struct thread *idle_thread = cpu_current ()->idle_thread;
+	int64_t now = timer_ticks ();
+
+	if (t != idle_thread)
+		t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+	/* Once per second: update load_avg, record the decay factor
+	   2*load_avg / (2*load_avg + 1) for recent_cpu and apply it to
+	   the running and ready threads, then let the scheduler run. */
+	if (now % TIMER_FREQ == 0) {
+		int ready_cnt = runq_ready_cnt ();
+		int ready = ready_cnt + (t != idle_thread);
+		struct list *stale;
+		struct list expiring;
+		fixed_t twice_load;
+
+		load_avg = fp_div_int (fp_add (fp_mul_int (load_avg, 59),
+					fp_from_int (ready)), 60);
+		twice_load = fp_mul_int (load_avg, 2);
+		decay_history[mlfqs_epoch % DECAY_HISTORY] =
+			fp_div (twice_load, fp_add_int (twice_load, 1));
+		mlfqs_epoch++;
+
+		/* The oldest decay factor still needed by threads in
+		   STALE is overwritten next second. */
+		stale = &mlfqs_stale[mlfqs_epoch % DECAY_HISTORY];
+		list_init (&expiring);
+		while (!list_empty (stale))
+			list_push_back (&expiring, list_pop_front (stale));
+		while (!list_empty (&expiring)) {
+			struct thread *s = list_entry (list_pop_front (&expiring),
+					struct thread, mlfqs_elem);
+
+			list_push_back (stale, &s->mlfqs_elem);
+			mlfqs_catch_up (s);
+		}
+
+		if (t != idle_thread)
+			mlfqs_catch_up (t);
+		mlfqs_update_ready ();
+		if (ready_cnt > 0)
+			intr_yield_on_return ();
+	}
+
+	/* Every fourth tick: recent_cpu of the running thread has
+	   grown, so its priority may have dropped. */
+	if (now % 4 == 0 && t != idle_thread) {
+		t->priority = mlfqs_priority (t);
+		if (t->priority < runq_max_priority ())
+			intr_yield_on_return ();
+	}
+}
+
+/* Applies to T's recent_cpu the once-per-second decays it has
+   missed since it was last brought up to date, and moves it to
+   the matching mlfqs_stale list.  Interrupts must be off. */
+static void
+mlfqs_catch_up (struct thread *t) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (mlfqs_epoch - t->mlfqs_epoch <= DECAY_HISTORY);
+
+	if (t->mlfqs_epoch == mlfqs_epoch)
+		return;
+	for (; t->mlfqs_epoch != mlfqs_epoch; t->mlfqs_epoch++)
+		t->recent_cpu = fp_add_int (fp_mul (decay_history[t->mlfqs_epoch
+					% DECAY_HISTORY], t->recent_cpu), t->nice);
+	list_remove (&t->mlfqs_elem);
+	list_push_back (&mlfqs_stale[mlfqs_epoch % DECAY_HISTORY],
+			&t->mlfqs_elem);
+}
+
+/* Brings every thread in the running CPU's run queue up to date
+   with the decays so far and moves those whose priority changed
+   to the end of the queue for their new priority.  Interrupts
+   must be off. */
+static void
+mlfqs_update_ready (void) {
+	struct runqueue *rq = &runqueues[cpu_current ()->id];
+	struct list moved;
+
+	list_init (&moved);
+	spin_lock (&rq->lock);
+	for (int pri = PRI_MIN; pri <= PRI_MAX; pri++) {
+		struct list *queue = &rq->queues[pri];
+		struct list_elem *e = list_begin (queue);
+
+		while (e != list_end (queue)) {
+			struct thread *t = list_entry (e, struct thread, elem);
+
+			e = list_next (e);
+			mlfqs_catch_up (t);
+			t->priority = mlfqs_priority (t);
+			if (t->priority != pri) {
+				list_remove (&t->elem);
+				list_push_back (&moved, &t->elem);
+				rq->cnt--;
+			}
+		}
+		if (list_empty (queue))
+			rq->mask &= ~(1ULL << (PRI_MAX - pri));
+	}
+	while (!list_empty (&moved))
+		runq_insert (rq, list_entry (list_pop_front (&moved),
+					struct thread, elem));
+	spin_unlock (&rq->lock);
+}
+
+/* Returns the MLFQS priority of T,
+   PRI_MAX - recent_cpu / 4 - nice * 2, clamped to the valid
+   range. */
+static int
+mlfqs_priority (const struct thread *t) {
+	int priority = PRI_MAX - fp_to_int (fp_div_int (t->recent_cpu, 4))
+		- t->nice * 2;
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+	return priority;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -459,7 +852,7 @@ static void
 idle (void *idle_started_ UNUSED) {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current ();
+	cpu_current ()->idle_thread = thread_current ();
 	sema_up (idle_started);
 
 	for (;;) {
@@ -467,6 +860,14 @@ idle (void *idle_started_ UNUSED) {
 		intr_disable ();
 		thread_block ();
 
+		/* Nothing else to do, so zero pages for PAL_ZERO requests
+		   until a thread becomes ready or there is nothing left to
+		   zero.  Go back to the scheduler in the former case. */
+		while (runq_ready_cnt () == 0 && palloc_zero_idle ())
+			continue;
+		if (runq_ready_cnt () > 0)
+			continue;
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -478,7 +879,11 @@ idle (void *idle_started_ UNUSED) {
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
+		   7.11.1 "HLT Instruction".
+
+		   Unless something is due on the next tick, the periodic
+		   timer interrupt is stopped until the first one is. */
+		timer_idle_enter ();
 		asm volatile ("sti; hlt" : : : "memory");
 	}
 }
@@ -511,7 +916,8 @@ init_thread (struct thread *t, const char *name, int priority) {
 
 	//priotity, donation
 	t->original_priority = priority;
-	list_init(&t->donations);
+	t->held_cnt = 0;
+	list_init (&t->held_extra);
 
 	//system call
 	t->exit_status = 0;
@@ -522,17 +928,97 @@ init_thread (struct thread *t, const char *name, int priority) {
 	sema_init(&t->exit_sema,0);
 	sema_init(&t->wait_sema,0);
 }
+
+/* Appends T to the running CPU's run queue, at its current
+   priority.  Interrupts must be off. */
+static void
+runq_push (struct thread *t) {
+	struct runqueue *rq = &runqueues[cpu_current ()->id];
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spin_lock (&rq->lock);
+	runq_insert (rq, t);
+	spin_unlock (&rq->lock);
+}
+
+/* Appends T to RQ at its current priority.  RQ's lock must be
+   held. */
+static void
+runq_insert (struct runqueue *rq, struct thread *t) {
+	ASSERT (spin_lock_held (&rq->lock));
+	ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	rq->cnt++;
+	t->runq = rq - runqueues;
+	if (t->edf_period != 0) {
+		list_insert_ordered (&rq->edf, &t->elem, edf_deadline_less, NULL);
+		return;
+	}
+	list_push_back (&rq->queues[t->priority], &t->elem);
+	rq->mask |= 1ULL << (PRI_MAX - t->priority);
+}
+
+/* Removes and returns the highest-priority thread in RQ, or a
+   null pointer if RQ is empty.  RQ's lock must be held. */
+static struct thread *
+runq_pop (struct runqueue *rq) {
+	struct list *queue;
+	struct thread *t;
+	int pri;
+
+	ASSERT (spin_lock_held (&rq->lock));
+
+	if (!list_empty (&rq->edf)) {
+		rq->cnt--;
+		return list_entry (list_pop_front (&rq->edf), struct thread, elem);
+	}
+	if (rq->mask == 0)
+		return NULL;
+
+	pri = PRI_MAX - (int) bsf (rq->mask);
+	queue = &rq->queues[pri];
+	t = list_entry (list_pop_front (queue), struct thread, elem);
+	if (list_empty (queue))
+		rq->mask &= ~(1ULL << (PRI_MAX - pri));
+	rq->cnt--;
+	return t;
+}
+
+/* Returns the highest priority among threads ready on the
+   running CPU, PRI_MAX + 1 if an EDF thread is ready, or -1 if
+   its run queue is empty.  The answer may be stale by the time
+   the caller looks at it unless interrupts are off. */
+static int
+runq_max_priority (void) {
+	struct runqueue *rq = &runqueues[cpu_current ()->id];
+	uint64_t mask = rq->mask;
+
+	if (!list_empty (&rq->edf))
+		return PRI_MAX + 1;
+	return mask != 0 ? PRI_MAX - (int) bsf (mask) : -1;
+}
+
+/* Returns the number of threads ready on the running CPU. */
+static int
+runq_ready_cnt (void) {
+	return runqueues[cpu_current ()->id].cnt;
+}
+
 /* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   return a thread from the running CPU's run queue, unless the
+   run queue is empty.  (If the running thread can continue
+   running, then it will be in the run queue.)  If the run queue
+   is empty, return idle_thread. */
 static struct thread *
 next_thread_to_run (void) {
-	if (list_empty (&ready_list))
-		return idle_thread;
-	else
-		return list_entry (list_pop_front (&ready_list), struct thread, elem);
+	struct runqueue *rq = &runqueues[cpu_current ()->id];
+	struct thread *next;
+
+	spin_lock (&rq->lock);
+	next = runq_pop (rq);
+	spin_unlock (&rq->lock);
+	return next != NULL ? next : cpu_current ()->idle_thread;
 }
 
 /* Use iretq to launch the thread
@@ -663,7 +1149,7 @@ schedule (void) {
 	next->status = THREAD_RUNNING;
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	cpu_current ()->thread_ticks = 0;
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -704,14 +1190,6 @@ allocate_tid (void) {
 	return tid;
 }
 
-//sleep_list에 들어가는 elem을 tick이 짧은 순서대로 오름차순 정렬
-bool
-sleep_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	struct thread *ta = list_entry(a, struct thread, elem);
-	struct thread *tb = list_entry(b, struct thread, elem);
-	return ta->wakeup_tick < tb->wakeup_tick;
-}
-
 //우선순위내림차순 정렬
 bool
 cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
@@ -720,10 +1198,3 @@ cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNU
 	return ta->priority > tb->priority;
 }
 
-//donations 리스트에 들어가는 d_elem을 priority 기준으로 정렬(내림차순)
-bool
-cmp_donor_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED) {
-	struct thread *ta = list_entry(a, struct thread, d_elem);
-	struct thread *tb = list_entry(b, struct thread, d_elem);
-	return ta->priority > tb->priority;
-}
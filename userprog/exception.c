@@ -4,6 +4,7 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "userprog/process.h"
 #include "intrinsic.h"
 
 /* Number of page faults processed. */
@@ -144,6 +145,11 @@ page_fault (struct intr_frame *f) {
 	/* For project 3 and later. */
 	if (vm_try_handle_fault (f, fault_addr, user, write, not_present))
 		return;
+#else
+	/* Write to a page shared copy-on-write by fork(), by the
+	   process or by the kernel on its behalf. */
+	if (!not_present && write && process_handle_cow (fault_addr))
+		return;
 #endif
 
 	/* Count page faults. */
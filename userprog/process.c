@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -107,13 +108,49 @@ process_fork (const char *name, struct intr_frame *if_ UNUSED) {
 }
 
 #ifndef VM
+bool process_cow = true;
+
+/* Copy-on-write statistics. */
+static long long cow_shared;            /* Pages shared by fork(). */
+static long long cow_copied;            /* Pages copied on a write fault. */
+static long long cow_reused;            /* Pages whose last sharer wrote them. */
+
+/* Passed to duplicate_pte(). */
+struct fork_copy {
+	struct thread *parent;
+	struct tlb_gather tlb;              /* Parent pages made read-only. */
+};
+
+/* Shares the parent's page PARENT_PAGE, mapped at VA by PTE, with
+ * the child.  If it is writable, both processes map it read-only
+ * with PTE_COW set, so that the first write by either of them
+ * faults into process_handle_cow(). */
+static bool
+share_pte (uint64_t *pte, void *va, void *parent_page, struct fork_copy *copy) {
+	struct thread *current = thread_current ();
+	bool cow = (*pte & (PTE_W | PTE_COW)) != 0;
+
+	if (*pte & PTE_W) {
+		*pte = (*pte & ~PTE_W) | PTE_COW;
+		tlb_gather_add (&copy->tlb, va);
+	}
+	if (!pml4_set_page (current->pml4, va, parent_page, false))
+		return false;
+	if (cow)
+		*pml4e_walk (current->pml4, (uint64_t) va, false) |= PTE_COW;
+	palloc_share_page (parent_page);
+	cow_shared++;
+	return true;
+}
+
 /* Duplicate the parent's address space by passing this function to the
  * pml4_for_each. This is only for the project 2. 
    pml4_for_each에 전달하여 부모의 주소 공간을 복제한다.*/
 static bool
 duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	struct thread *current = thread_current ();
-	struct thread *parent = (struct thread *) aux;
+	struct fork_copy *copy = aux;
+	struct thread *parent = copy->parent;
 	void *parent_page;
 	void *newpage;
 	bool writable;
@@ -126,6 +163,8 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	parent_page = pml4_get_page (parent->pml4, va);
 	if(parent_page == NULL)
 		return false;
+	if (process_cow)
+		return share_pte (pte, va, parent_page, copy);
 
 	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
 	 *    TODO: NEWPAGE. */
@@ -137,16 +176,60 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	 *    TODO: check whether parent's page is writable or not (set WRITABLE
 	 *    TODO: according to the result). */
 	memcpy(newpage, parent_page, PGSIZE);
-	writable = is_writable(pte);	//쓰기 가능
+	writable = (*pte & (PTE_W | PTE_COW)) != 0;	//쓰기 가능
 
 	/* 5. Add new page to child's page table at address VA with WRITABLE
 	 *    permission. */
 	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
 		/* 6. TODO: if fail to insert page, do error handling. */
+		palloc_free_page (newpage);
 		return false; 
 	}
+	cow_copied++;
 	return true;
 }
+
+/* Handles a write fault at user address ADDR in a copy-on-write
+ * page of the running process: gives the process its own copy of
+ * the page, or, if no other process shares it anymore, just makes
+ * it writable again.  Returns false if ADDR is not in such a page
+ * or memory is exhausted. */
+bool
+process_handle_cow (void *addr) {
+	struct thread *curr = thread_current ();
+	void *upage = pg_round_down (addr);
+	uint64_t *pte;
+	void *kpage, *newpage;
+
+	if (curr->pml4 == NULL || !is_user_vaddr (addr))
+		return false;
+	pte = pml4e_walk (curr->pml4, (uint64_t) upage, false);
+	if (pte == NULL || (*pte & (PTE_P | PTE_COW)) != (PTE_P | PTE_COW))
+		return false;
+
+	kpage = ptov (PTE_ADDR (*pte));
+	if (palloc_page_refs (kpage) == 1) {
+		pml4_set_page (curr->pml4, upage, kpage, true);
+		cow_reused++;
+		return true;
+	}
+
+	newpage = palloc_get_page (PAL_USER);
+	if (newpage == NULL)
+		return false;
+	memcpy (newpage, kpage, PGSIZE);
+	pml4_set_page (curr->pml4, upage, newpage, true);
+	palloc_free_page (kpage);
+	cow_copied++;
+	return true;
+}
+
+/* Prints copy-on-write statistics. */
+void
+process_print_stats (void) {
+	printf ("Fork: %lld pages shared, %lld copied, %lld reused\n",
+			cow_shared, cow_copied, cow_reused);
+}
 #endif
 
 /* A thread function that copies parent's execution context.
@@ -180,8 +263,16 @@ __do_fork (void *aux) {
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
 #else
-	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
-		goto error;
+	{
+		struct fork_copy copy = { .parent = parent };
+		bool copied;
+
+		tlb_gather_init (&copy.tlb, parent->pml4);
+		copied = pml4_for_each (parent->pml4, duplicate_pte, &copy);
+		tlb_gather_finish (&copy.tlb);
+		if (!copied)
+			goto error;
+	}
 #endif
 
 	/* TODO: Your code goes here.
@@ -206,7 +297,7 @@ __do_fork (void *aux) {
 			struct file *file = file_duplicate(fd->file);
 			if (file != NULL) {
 				// 파일을 복제한 후, 새로운 파일 디스크립터 테이블에 추가한다.
-				struct file_descriptor *new_fd = malloc(sizeof(struct file_descriptor));
+				struct file_descriptor *new_fd = fd_alloc();
 				if (new_fd != NULL) {
 					new_fd->file = file;
 					new_fd->fd_num = fd->fd_num;
@@ -384,7 +475,8 @@ process_exit (void) {
 	{
 		e = list_pop_front(fd_list);
 		fd = list_entry(e, struct file_descriptor, fd_elem);
-		close(fd);
+		file_close(fd->file);
+		fd_free(fd);
 	}
 
 	//현재 실행 중인 파일을 닫는다.
@@ -762,11 +854,18 @@ install_page (void *upage, void *kpage, bool writable) {
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
+/* Loads PAGE of a segment from the executable, on first access.
+ * AUX is the segment's range.  The frame is already zeroed, so
+ * only the bytes the file backs need reading. */
 static bool
 lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
+	struct vm_range *range = aux;
+	size_t ofs = (uint8_t *) page->va - range->start;
+	size_t read_bytes = range->read_bytes - ofs < PGSIZE
+		? range->read_bytes - ofs : PGSIZE;
+
+	return file_read_at (range->file, page->frame->kva, read_bytes,
+			range->offset + ofs) == (off_t) read_bytes;
 }
 
 /* Loads a segment starting at offset OFS in FILE at address
@@ -790,6 +889,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
+	/* All pages share the segment's range as aux. */
+	struct vm_range *range = spt_add_range (&thread_current ()->spt, upage,
+			read_bytes + zero_bytes, RANGE_SEGMENT, writable, file, ofs,
+			read_bytes);
+	if (range == NULL)
+		return false;
+
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
@@ -797,10 +903,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+		/* Pages past the end of the file's data, such as the BSS,
+		   need no loading at all, which also lets them be backed by
+		   transparent huge pages. */
+		if (!vm_alloc_page_with_initializer (VM_ANON, upage, writable,
+					page_read_bytes > 0 ? lazy_load_segment : NULL,
+					page_read_bytes > 0 ? range : NULL))
 			return false;
 
 		/* Advance. */
@@ -817,10 +925,16 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
+	/* The stack grows on demand within its range; VM_MARKER_0 marks
+	   stack pages. */
+	if (spt_add_range (&thread_current ()->spt,
+				(uint8_t *) USER_STACK - VM_STACK_MAX, VM_STACK_MAX,
+				RANGE_STACK, true, NULL, 0, 0) != NULL
+			&& vm_alloc_page (VM_ANON | VM_MARKER_0, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 
 	return success;
 }
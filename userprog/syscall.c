@@ -15,6 +15,10 @@
 #include "include/lib/user/syscall.h"
 #include "devices/input.h"
 #include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/mmu.h"
+#include <hash.h>
 
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
@@ -30,15 +34,51 @@ int write (int fd, const void *buffer, unsigned length);
 void seek (int fd, unsigned position);
 unsigned tell (int fd);
 void close (int fd);
+int futex (int *uaddr, int op, int val);
+#ifdef VM
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
+void munmap (void *addr);
+#endif
 
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 void check_address(void *file_addr);
 void check_buffer(void *buffer);
+void check_buffer_range(const void *buffer, unsigned length, bool write);
+void pin_buffer(const void *buffer, unsigned length, bool write);
+void unpin_buffer(const void *buffer, unsigned length);
 int process_add_file(struct file *file);
 struct file_descriptor *find_file_descriptor(int fd);
 
 static struct intr_frame *frame;
+
+/* Futex wait queues.
+
+   A futex is keyed on the kernel virtual address of the user
+   word, i.e. on its physical page and offset, not on the user
+   address, so that processes mapping the same page at different
+   addresses find the same waiters.  Waiters are hashed into
+   FUTEX_BUCKETS buckets, each with its own lock. */
+#define FUTEX_BUCKETS 64
+
+struct futex_bucket {
+	struct lock lock;
+	struct list waiters;        /* List of struct futex_waiter. */
+};
+
+/* A thread sleeping in FUTEX_WAIT.  Lives on its stack. */
+struct futex_waiter {
+	const int *key;             /* Kernel address of the user word. */
+	struct semaphore sema;      /* Upped by FUTEX_WAKE. */
+	struct list_elem elem;      /* struct futex_bucket `waiters' element. */
+};
+
+static struct futex_bucket futex_buckets[FUTEX_BUCKETS];
+
+/* Cache of `struct file_descriptor's. */
+static struct kmem_cache *fd_cache;
+
+static struct futex_bucket *futex_bucket (const int *key);
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -63,6 +103,26 @@ syscall_init (void) {
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	for (int i = 0; i < FUTEX_BUCKETS; i++) {
+		lock_init (&futex_buckets[i].lock);
+		list_init (&futex_buckets[i].waiters);
+	}
+	fd_cache = kmem_cache_create ("file_descriptor",
+			sizeof (struct file_descriptor), NULL);
+}
+
+/* Allocates a file descriptor, or returns a null pointer if
+   memory is not available. */
+struct file_descriptor *
+fd_alloc (void) {
+	return kmem_cache_alloc (fd_cache);
+}
+
+/* Frees file descriptor FD, allocated with fd_alloc(). */
+void
+fd_free (struct file_descriptor *fd) {
+	kmem_cache_free (fd_cache, fd);
 }
 
 /* The main system call interface */
@@ -73,6 +133,10 @@ syscall_handler (struct intr_frame *f UNUSED)
 {
 	frame = f;
 	int sys_num = f->R.rax;	 //시스템 콜 번호
+#ifdef VM
+	/* For stack growth on faults in the kernel. */
+	thread_current()->user_rsp = f->rsp;
+#endif
 	switch(sys_num)
 	{
 		case SYS_HALT:
@@ -114,6 +178,17 @@ syscall_handler (struct intr_frame *f UNUSED)
 		case SYS_CLOSE:
 			close(f->R.rdi);
 			break;	
+		case SYS_FUTEX:
+			f->R.rax = futex((int *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+#ifdef VM
+		case SYS_MMAP:
+			f->R.rax = (uint64_t) mmap((void *) f->R.rdi, f->R.rsi, f->R.rdx, f->R.r10, f->R.r8);
+			break;
+		case SYS_MUNMAP:
+			munmap((void *) f->R.rdi);
+			break;
+#endif
 
 		default:
 			break;
@@ -193,6 +268,7 @@ int filesize (int fd)
 int read (int fd, void *buffer, unsigned length)
 {
 	check_buffer(buffer);
+	check_buffer_range(buffer, length, true);
 	
 	int byte = 0;
 	char *ptr = (char *)buffer;
@@ -208,7 +284,9 @@ int read (int fd, void *buffer, unsigned length)
 	{
 		struct file_descriptor *curr_fd = find_file_descriptor(fd);
 		if(curr_fd == NULL) return -1;
+		pin_buffer(buffer, length, true);
 		byte = file_read(curr_fd->file, buffer, length);
+		unpin_buffer(buffer, length);
 	}
 	return byte;
 }
@@ -217,6 +295,7 @@ int read (int fd, void *buffer, unsigned length)
 int write (int fd, const void *buffer, unsigned length)
 {
 	check_buffer(buffer);
+	check_buffer_range(buffer, length, false);
 	int byte = 0;
 	if(fd == 1)
 	{
@@ -226,7 +305,9 @@ int write (int fd, const void *buffer, unsigned length)
 	{
 		struct file_descriptor *curr_fd = find_file_descriptor(fd);
 		if(curr_fd == NULL) return NULL;
+		pin_buffer(buffer, length, false);
 		byte = file_write(curr_fd->file, buffer, length);
+		unpin_buffer(buffer, length);
 	}
 	return byte;
 }
@@ -253,7 +334,86 @@ void close (int fd)
 
 	list_remove(&curr_fd->fd_elem);
 	file_close(curr_fd->file);
-	free(curr_fd);
+	fd_free(curr_fd);
+}
+
+//UADDR에서 잠들거나(FUTEX_WAIT) 잠든 스레드를 깨운다(FUTEX_WAKE).
+int futex (int *uaddr, int op, int val)
+{
+	struct futex_bucket *b;
+	const int *key;
+	int woken = 0;
+
+	/* An aligned int never straddles a page boundary. */
+	if ((uint64_t) uaddr % sizeof *uaddr != 0)
+		return -1;
+	check_address(uaddr);
+	check_buffer_range(uaddr, sizeof *uaddr, false);
+	/* The key is the word's frame, so the page must stay in it
+	   from the lookup to the value read, and for a waiter until it
+	   is woken up: evicted, it would come back in another frame,
+	   where a FUTEX_WAKE would not find the waiter. */
+	pin_buffer(uaddr, sizeof *uaddr, false);
+	key = (const int *) pml4_get_page(thread_current()->pml4, uaddr);
+	ASSERT(key != NULL);
+	b = futex_bucket(key);
+
+	switch(op)
+	{
+		case FUTEX_WAIT:
+		{
+			struct futex_waiter w;
+
+			/* Checking the value and queueing up both happen under
+			   the bucket lock, so a FUTEX_WAKE that follows a change
+			   to the value cannot be lost. */
+			lock_acquire(&b->lock);
+			if(*(volatile const int *) key != val)
+			{
+				lock_release(&b->lock);
+				unpin_buffer(uaddr, sizeof *uaddr);
+				return -1;
+			}
+			w.key = key;
+			sema_init(&w.sema, 0);
+			list_push_back(&b->waiters, &w.elem);
+			lock_release(&b->lock);
+
+			sema_down(&w.sema);
+			unpin_buffer(uaddr, sizeof *uaddr);
+			return 0;
+		}
+		case FUTEX_WAKE:
+		{
+			struct list_elem *e;
+
+			lock_acquire(&b->lock);
+			for(e = list_begin(&b->waiters); e != list_end(&b->waiters) && woken < val; )
+			{
+				struct futex_waiter *w = list_entry(e, struct futex_waiter, elem);
+				e = list_next(e);
+				if(w->key == key)
+				{
+					list_remove(&w->elem);
+					sema_up(&w->sema);
+					woken++;
+				}
+			}
+			lock_release(&b->lock);
+			unpin_buffer(uaddr, sizeof *uaddr);
+			return woken;
+		}
+		default:
+			unpin_buffer(uaddr, sizeof *uaddr);
+			return -1;
+	}
+}
+
+/* Returns the wait queue bucket for futex KEY. */
+static struct futex_bucket *
+futex_bucket (const int *key)
+{
+	return &futex_buckets[hash_bytes(&key, sizeof key) % FUTEX_BUCKETS];
 }
 
 bool remove (const char *file)
@@ -262,28 +422,88 @@ bool remove (const char *file)
 	return filesys_remove(file);
 }
 
+#ifdef VM
+/* Maps a file into memory at ADDR. */
+void *mmap (void *addr, size_t length, int writable, int fd, off_t offset)
+{
+	struct file_descriptor *curr_fd = find_file_descriptor(fd);
+	if(curr_fd == NULL || curr_fd->file == NULL)
+		return NULL;
+	return do_mmap(addr, length, writable, curr_fd->file, offset);
+}
+
+/* Removes the mapping that starts at ADDR. */
+void munmap (void *addr)
+{
+	do_munmap(addr);
+}
+#endif
+
+/* Returns true if user address ADDR is mapped, or, with virtual
+   memory, may be faulted in. */
+static bool
+is_user_mapped (const void *addr)
+{
+#ifdef VM
+	return vm_prefault(addr, 1, false);
+#else
+	return pml4_get_page(thread_current()->pml4, addr) != NULL;
+#endif
+}
+
 // 유효한 주소값인지 확인
 void check_address(void *file_addr)
 {
-	struct thread *t = thread_current();
-	if(file_addr == "\0" || file_addr == NULL || !is_user_vaddr(file_addr) || pml4_get_page(t->pml4, file_addr) == NULL)
+	if(file_addr == "\0" || file_addr == NULL || !is_user_vaddr(file_addr) || !is_user_mapped(file_addr))
 		exit(-1);
 }
 
 // 유효한 버퍼 주소 값인지 확인
 void check_buffer(void *buffer)
 {
-	struct thread *t = thread_current();
-	if(!is_user_vaddr(buffer) || pml4_get_page(t->pml4, buffer) == NULL)
+	if(!is_user_vaddr(buffer) || !is_user_mapped(buffer))
 		exit(-1);
 }
 
+/* Checks all LENGTH bytes of BUFFER, which the kernel will write
+   if WRITE.  With virtual memory, also faults them in. */
+void check_buffer_range(const void *buffer UNUSED, unsigned length UNUSED,
+		bool write UNUSED)
+{
+#ifdef VM
+	if(!vm_prefault(buffer, length, write))
+		exit(-1);
+#endif
+}
+
+/* Keeps the LENGTH bytes of BUFFER in memory until unpin_buffer():
+   the file system may read from disk straight into BUFFER, and a
+   fault there could need the disk itself. */
+void pin_buffer(const void *buffer UNUSED, unsigned length UNUSED,
+		bool write UNUSED)
+{
+#ifdef VM
+	if(!vm_pin(buffer, length, write))
+		exit(-1);
+#endif
+}
+
+/* Undoes pin_buffer(BUFFER, LENGTH, ...). */
+void unpin_buffer(const void *buffer UNUSED, unsigned length UNUSED)
+{
+#ifdef VM
+	vm_unpin(buffer, length);
+#endif
+}
+
 //현재 스레드의 파일 디스크립터에 현재 파일을 추가한다.
 int process_add_file(struct file *file)
 {
 	struct thread *curr = thread_current();
-	struct file_descriptor *cur_fd = malloc(sizeof(struct file_descriptor));
+	struct file_descriptor *cur_fd = fd_alloc();
 	struct list *fd_list = &thread_current()->fd_list;
+	if(cur_fd == NULL)
+		return -1;
 	
 	cur_fd->file = file;
 	cur_fd->fd_num = (curr->last_create_fd)++;	
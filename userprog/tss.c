@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -45,22 +46,30 @@
  *      stack pointer to point to the new thread's kernel stack.
  *      (The call is in schedule in thread.c.) */
 
-/* Kernel TSS. */
+/* Kernel TSS of the bootstrap processor.  syscall-entry.S reads
+   the ring 0 stack pointer through it; it has to switch to a
+   per-CPU lookup (swapgs) before other CPUs can take system
+   calls. */
 struct task_state *tss;
 
-/* Initializes the kernel TSS. */
+/* Initializes the running CPU's kernel TSS.  Each CPU has its
+   own, kept in its struct cpu. */
 void
 tss_init (void) {
 	/* Our TSS is never used in a call gate or task gate, so only a
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
-	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	cpu_current ()->tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	if (cpu_current ()->id == 0)
+		tss = cpu_current ()->tss;
 	tss_update (thread_current ());
 }
 
 /* Returns the kernel TSS. */
 struct task_state *
 tss_get (void) {
+	struct task_state *tss = cpu_current ()->tss;
+
 	ASSERT (tss != NULL);
 	return tss;
 }
@@ -69,6 +78,8 @@ tss_get (void) {
  * of the thread stack. */
 void
 tss_update (struct thread *next) {
+	struct task_state *tss = cpu_current ()->tss;
+
 	ASSERT (tss != NULL);
 	tss->rsp0 = (uint64_t) next + PGSIZE;
 }
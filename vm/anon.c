@@ -1,7 +1,44 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/disk.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in a swap slot, which holds one page. */
+#define SLOT_SECTORS (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Number of slots a process reserves at once for its evicted
+   pages. */
+#define CLUSTER_SLOTS 16
+
+/* Fixed budget of the compressed swap cache, in bytes of entries. */
+#define ZCACHE_BUDGET (512 * 1024)
+
+/* Pages that do not compress to this size, header included, go
+   straight to the swap disk.  It is also malloc()'s largest block
+   short of a whole page. */
+#define ZCACHE_MAX_ENTRY 3072
+
+/* A compressed page in the swap cache.  A zero-filled page has
+   size 0. */
+struct zcache_entry {
+	struct list_elem elem;      /* In zcache_lru, oldest first. */
+	struct page *page;          /* Page whose contents these are. */
+	size_t size;                /* Bytes in DATA. */
+	uint8_t data[];             /* LZ-compressed contents. */
+};
+
+/* Process and page whose contents are in a swap slot. */
+struct slot_user {
+	struct thread *owner;
+	struct page *page;
+};
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk *swap_disk;
@@ -17,36 +54,460 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap slots and swap cache.  swap_lock protects both maps, the
+   clusters reserved in supplemental page tables, the cache and
+   where each swapped-out page is. */
+static struct bitmap *swap_map;          /* Allocated or reserved slots. */
+static struct slot_user *slot_users;     /* Who is in each slot. */
+static struct list zcache_lru;           /* Cache entries, oldest first. */
+static size_t zcache_used;               /* Bytes of entries in the cache. */
+static struct lock swap_lock;
+
+/* Scratch space, under swap_lock: zcache_buf holds a page being
+   compressed while zcache_spill() rebuilds older pages in
+   spill_buf to make room for it. */
+static uint8_t zcache_buf[PGSIZE];
+static uint8_t spill_buf[PGSIZE];
+
+/* Statistics. */
+static long long swap_out_cnt;      /* Pages written to swap. */
+static long long swap_out_seq_cnt;  /* ...right after the last one written. */
+static long long swap_in_cnt;       /* Pages read back from swap. */
+static size_t last_slot = BITMAP_ERROR;  /* Slot written last. */
+static long long zcache_stores;     /* Pages put in the swap cache. */
+static long long zcache_zero;       /* ...of which zero-filled. */
+static long long zcache_bytes;      /* Bytes of the entries put in. */
+static long long zcache_rejects;    /* Pages that did not compress. */
+static long long zcache_hits;       /* Pages swapped in from the cache. */
+static long long zcache_drops;      /* Pages freed while in the cache. */
+static long long zcache_spills;     /* Pages moved to the swap disk. */
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	size_t slot_cnt;
+
+	swap_disk = disk_get (1, 1);
+	list_init (&zcache_lru);
+	lock_init (&swap_lock);
+	if (swap_disk == NULL)
+		return;
+
+	slot_cnt = disk_size (swap_disk) / SLOT_SECTORS;
+	swap_map = bitmap_create (slot_cnt);
+	slot_users = calloc (slot_cnt, sizeof *slot_users);
+	if (swap_map == NULL || slot_users == NULL)
+		PANIC ("out of memory for %zu swap slots", slot_cnt);
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &anon_ops;
 
 	struct anon_page *anon_page = &page->anon;
+	anon_page->slot = BITMAP_ERROR;
+	anon_page->zentry = NULL;
+	return true;
+}
+
+/* LZ compression.
+ *
+ * A compressed page is a sequence of tokens.  A control byte C
+ * below 0x80 is followed by C + 1 literal bytes.  Otherwise it
+ * stands for a copy of (C & 0x7f) + LZ_MIN_MATCH bytes from the
+ * distance given by the next two bytes, little-endian, back in
+ * the page being rebuilt.  The copy may overlap the bytes it
+ * produces, which is how runs are encoded. */
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (0x7f + LZ_MIN_MATCH)
+#define LZ_MAX_LITERALS 0x80
+#define LZ_HASH_BITS 12
+
+/* For each hash of 4 bytes, the offset plus 1 of the last place
+   they were seen, or 0.  Used under swap_lock. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+
+static uint32_t
+lz_read32 (const uint8_t *p) {
+	uint32_t x;
+	memcpy (&x, p, sizeof x);
+	return x;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Appends SRC[START, END) to DST as literal tokens at *OP.
+ * Returns false if they would take DST past LIMIT bytes. */
+static bool
+lz_literals (const uint8_t *src, size_t start, size_t end,
+		uint8_t *dst, size_t *op, size_t limit) {
+	while (start < end) {
+		size_t cnt = end - start < LZ_MAX_LITERALS ? end - start
+			: LZ_MAX_LITERALS;
+
+		if (*op + 1 + cnt > limit)
+			return false;
+		dst[(*op)++] = cnt - 1;
+		memcpy (dst + *op, src + start, cnt);
+		*op += cnt;
+		start += cnt;
+	}
+	return true;
+}
+
+/* Compresses the page at SRC into DST.  Returns the compressed
+ * size, or 0 if it would exceed LIMIT bytes. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t limit) {
+	size_t ip = 0, anchor = 0, op = 0;
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (ip + LZ_MIN_MATCH <= PGSIZE) {
+		uint32_t seq = lz_read32 (src + ip);
+		uint32_t hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+		size_t ref = lz_table[hash];
+		size_t len;
+
+		lz_table[hash] = ip + 1;
+		if (ref == 0 || lz_read32 (src + --ref) != seq) {
+			ip++;
+			continue;
+		}
+
+		len = LZ_MIN_MATCH;
+		while (ip + len < PGSIZE && len < LZ_MAX_MATCH
+				&& src[ref + len] == src[ip + len])
+			len++;
+		if (!lz_literals (src, anchor, ip, dst, &op, limit)
+				|| op + 3 > limit)
+			return 0;
+		dst[op++] = 0x80 | (len - LZ_MIN_MATCH);
+		dst[op++] = (ip - ref) & 0xff;
+		dst[op++] = (ip - ref) >> 8;
+		ip += len;
+		anchor = ip;
+	}
+	if (!lz_literals (src, anchor, PGSIZE, dst, &op, limit))
+		return 0;
+	return op;
+}
+
+/* Rebuilds the page at DST from the SIZE bytes at SRC that
+ * lz_compress() produced.  Returns false, with DST partly
+ * written, if they do not decode to exactly one page; no token
+ * reads past SRC + SIZE or writes past DST + PGSIZE. */
+static bool
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst) {
+	size_t ip = 0, op = 0;
+
+	while (ip < size) {
+		uint8_t c = src[ip++];
+
+		if (c < 0x80) {
+			size_t cnt = c + 1;
+
+			if (cnt > size - ip || cnt > PGSIZE - op)
+				return false;
+			memcpy (dst + op, src + ip, cnt);
+			ip += cnt;
+			op += cnt;
+		} else {
+			size_t len = (c & 0x7f) + LZ_MIN_MATCH;
+			size_t dist;
+
+			if (size - ip < 2)
+				return false;
+			dist = src[ip] | (src[ip + 1] << 8);
+			ip += 2;
+			if (dist == 0 || dist > op || len > PGSIZE - op)
+				return false;
+			for (; len > 0; len--, op++)
+				dst[op] = dst[op - dist];
+		}
+	}
+	return op == PGSIZE;
+}
+
+/* Returns true if the page at KVA is all zeros. */
+static bool
+page_is_zero (const void *kva) {
+	const uint64_t *p = kva;
+
+	for (size_t i = 0; i < PGSIZE / sizeof *p; i++)
+		if (p[i] != 0)
+			return false;
+	return true;
+}
+
+/* Returns a free slot for a page of SPT.  Each process fills a
+ * cluster of adjacent slots before it reserves the next, so that
+ * pages it evicts one after another lie next to each other on
+ * disk: they are written sequentially, and read back together by
+ * anon_swap_neighbors().  The caller must hold swap_lock.
+ * Returns BITMAP_ERROR if swap is full. */
+static size_t
+slot_alloc (struct supplemental_page_table *spt) {
+	if (spt->swap_left == 0) {
+		size_t cnt;
+
+		/* Take a smaller cluster when swap is fragmented. */
+		for (cnt = CLUSTER_SLOTS; cnt > 0; cnt /= 2) {
+			spt->swap_next = bitmap_scan_and_flip (swap_map, 0, cnt, false);
+			if (spt->swap_next != BITMAP_ERROR)
+				break;
+		}
+		if (cnt == 0)
+			return BITMAP_ERROR;
+		spt->swap_left = cnt;
+	}
+	spt->swap_left--;
+	return spt->swap_next++;
+}
+
+/* Frees SLOT.  The caller must hold swap_lock. */
+static void
+slot_free (size_t slot) {
+	slot_users[slot].owner = NULL;
+	slot_users[slot].page = NULL;
+	bitmap_reset (swap_map, slot);
+}
+
+/* Gives back the slots that SPT reserved but did not use. */
+void
+anon_release_slots (struct supplemental_page_table *spt) {
+	if (spt->swap_left == 0)
+		return;
+	lock_acquire (&swap_lock);
+	bitmap_set_multiple (swap_map, spt->swap_next, spt->swap_left, false);
+	spt->swap_left = 0;
+	lock_release (&swap_lock);
+}
+
+/* Stores in PAGES up to MAX pages of the same process that are in
+ * the swap slots following PAGE's, which were most likely evicted
+ * right after PAGE and so are likely to be needed soon after it,
+ * and returns their number.  PAGE must be swapped out. */
+size_t
+anon_swap_neighbors (struct page *page, struct page *pages[], size_t max) {
+	size_t slot = page->anon.slot;
+	size_t cnt = 0;
+
+	ASSERT (slot != BITMAP_ERROR);
+
+	lock_acquire (&swap_lock);
+	while (cnt < max && ++slot < bitmap_size (swap_map)
+			&& slot_users[slot].owner == page->owner)
+		pages[cnt++] = slot_users[slot].page;
+	lock_release (&swap_lock);
+	return cnt;
+}
+
+/* Takes a swap slot for PAGE, whose contents are to be written
+ * to it.  The caller must hold swap_lock.  Returns BITMAP_ERROR if
+ * swap is full. */
+static size_t
+slot_take (struct page *page) {
+	size_t slot;
+
+	if (swap_map == NULL)
+		return BITMAP_ERROR;
+	slot = slot_alloc (&page->owner->spt);
+	if (slot == BITMAP_ERROR)
+		return BITMAP_ERROR;
+	slot_users[slot].owner = page->owner;
+	slot_users[slot].page = page;
+	if (last_slot != BITMAP_ERROR && slot == last_slot + 1)
+		swap_out_seq_cnt++;
+	last_slot = slot;
+	swap_out_cnt++;
+	return slot;
+}
+
+/* Writes the page at KVA to swap slot SLOT. */
+static void
+slot_write (size_t slot, const void *kva) {
+	for (size_t i = 0; i < SLOT_SECTORS; i++)
+		disk_write (swap_disk, slot * SLOT_SECTORS + i,
+				(const uint8_t *) kva + i * DISK_SECTOR_SIZE);
+}
+
+/* Takes ENTRY out of the swap cache and frees it.  The caller must
+ * hold swap_lock. */
+static void
+zcache_remove (struct zcache_entry *entry) {
+	list_remove (&entry->elem);
+	zcache_used -= sizeof *entry + entry->size;
+	entry->page->anon.zentry = NULL;
+	free (entry);
+}
+
+/* Rebuilds the page in ENTRY at KVA.  Returns false if ENTRY is
+ * corrupt. */
+static bool
+zcache_load (const struct zcache_entry *entry, void *kva) {
+	if (entry->size == 0) {
+		memset (kva, 0, PGSIZE);
+		return true;
+	}
+	return lz_decompress (entry->data, entry->size, kva);
+}
+
+/* Moves the oldest page in the swap cache to the swap disk.  The
+ * caller must hold swap_lock, which also keeps the page's owner
+ * from swapping it in meanwhile.  Leaves zcache_buf alone.
+ * Returns false if swap is full or the entry is corrupt. */
+static bool
+zcache_spill (void) {
+	struct zcache_entry *entry =
+		list_entry (list_front (&zcache_lru), struct zcache_entry, elem);
+	struct page *page = entry->page;
+	size_t slot;
+
+	if (!zcache_load (entry, spill_buf))
+		return false;
+	slot = slot_take (page);
+	if (slot == BITMAP_ERROR)
+		return false;
+	slot_write (slot, spill_buf);
+	zcache_remove (entry);
+	page->anon.slot = slot;
+	zcache_spills++;
+	return true;
+}
+
+/* Puts the page at KVA in the swap cache, making room by spilling
+ * the oldest pages to disk.  The caller must hold swap_lock.
+ * Returns false if the page does not compress well or does not
+ * fit. */
+static bool
+zcache_store (struct page *page, const void *kva) {
+	struct zcache_entry *entry;
+	size_t size = 0;
+
+	if (!page_is_zero (kva)) {
+		size = lz_compress (kva, zcache_buf,
+				ZCACHE_MAX_ENTRY - sizeof *entry);
+		if (size == 0) {
+			zcache_rejects++;
+			return false;
+		}
+	}
+
+	while (zcache_used + sizeof *entry + size > ZCACHE_BUDGET
+			&& !list_empty (&zcache_lru))
+		if (!zcache_spill ())
+			return false;
+	entry = malloc (sizeof *entry + size);
+	if (entry == NULL)
+		return false;
+
+	entry->page = page;
+	entry->size = size;
+	memcpy (entry->data, zcache_buf, size);
+	list_push_back (&zcache_lru, &entry->elem);
+	zcache_used += sizeof *entry + size;
+	page->anon.zentry = entry;
+
+	zcache_stores++;
+	zcache_bytes += sizeof *entry + size;
+	if (size == 0)
+		zcache_zero++;
+	return true;
+}
+
+/* Swap in the page from the swap cache, or by reading its contents
+ * from the swap disk. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	size_t slot;
+
+	lock_acquire (&swap_lock);
+	if (anon_page->zentry != NULL) {
+		bool success = zcache_load (anon_page->zentry, kva);
+
+		if (success) {
+			zcache_remove (anon_page->zentry);
+			zcache_hits++;
+		}
+		lock_release (&swap_lock);
+		return success;
+	}
+	slot = anon_page->slot;
+	lock_release (&swap_lock);
+
+	if (slot == BITMAP_ERROR)
+		return false;
+	for (size_t i = 0; i < SLOT_SECTORS; i++)
+		disk_read (swap_disk, slot * SLOT_SECTORS + i,
+				(uint8_t *) kva + i * DISK_SECTOR_SIZE);
+
+	lock_acquire (&swap_lock);
+	slot_free (slot);
+	swap_in_cnt++;
+	lock_release (&swap_lock);
+	anon_page->slot = BITMAP_ERROR;
+	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
+/* Swap out the page to the swap cache or, if it does not compress,
+ * by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	size_t slot;
+
+	lock_acquire (&swap_lock);
+	if (zcache_store (page, page->frame->kva)) {
+		lock_release (&swap_lock);
+		return true;
+	}
+	slot = slot_take (page);
+	lock_release (&swap_lock);
+	if (slot == BITMAP_ERROR)
+		return false;
+
+	slot_write (slot, page->frame->kva);
+	anon_page->slot = slot;
+	return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	lock_acquire (&swap_lock);
+	if (anon_page->zentry != NULL) {
+		zcache_remove (anon_page->zentry);
+		zcache_drops++;
+	} else if (anon_page->slot != BITMAP_ERROR)
+		slot_free (anon_page->slot);
+	lock_release (&swap_lock);
+
+	if (page->frame != NULL)
+		vm_release_frame (page);
+}
+
+/* Prints swap statistics.  Every page swapped in from the cache
+ * saved writing and reading a slot, and every page freed there
+ * saved writing one. */
+void
+anon_print_stats (void) {
+	long long ratio = zcache_bytes > 0
+		? zcache_stores * PGSIZE * 100 / zcache_bytes : 0;
+	long long lookups = zcache_hits + swap_in_cnt;
+
+	printf ("Swap: %lld pages out (%lld sequential), %lld in, "
+			"%d sectors each\n",
+			swap_out_cnt, swap_out_seq_cnt, swap_in_cnt, SLOT_SECTORS);
+	printf ("Swap cache: %lld pages stored (%lld zero-filled, "
+			"%lld incompressible), compression %lld.%02lld:1\n",
+			zcache_stores, zcache_zero, zcache_rejects,
+			ratio / 100, ratio % 100);
+	printf ("Swap cache: %lld%% hits, %lld pages spilled to disk, "
+			"%lld sectors avoided\n",
+			lookups > 0 ? zcache_hits * 100 / lookups : 0, zcache_spills,
+			(zcache_hits * 2 + zcache_drops) * SLOT_SECTORS);
 }
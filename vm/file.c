@@ -1,6 +1,8 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include "threads/mmu.h"
+#include "threads/vaddr.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
@@ -21,38 +23,120 @@ vm_file_init (void) {
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva UNUSED) {
 	/* Set up the handler */
 	page->operations = &file_ops;
 
 	struct file_page *file_page = &page->file;
+	file_page->range = NULL;
+	return true;
 }
 
-/* Swap in the page by read contents from the file. */
+/* Returns the offset of PAGE in the range it belongs to. */
+static size_t
+page_range_ofs (struct page *page) {
+	return (uint8_t *) page->va - page->file.range->start;
+}
+
+/* Returns the number of bytes of PAGE that its file backs. */
+static size_t
+page_read_bytes (struct page *page) {
+	size_t ofs = page_range_ofs (page);
+	size_t read_bytes = page->file.range->read_bytes;
+
+	if (ofs >= read_bytes)
+		return 0;
+	return read_bytes - ofs < PGSIZE ? read_bytes - ofs : PGSIZE;
+}
+
+/* Swap in the page by read contents from the file.  The rest of
+ * the page past the end of the file is zero, since KVA is. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+	size_t read_bytes = page_read_bytes (page);
+
+	return file_read_at (file_page->range->file, kva, read_bytes,
+			file_page->range->offset + page_range_ofs (page))
+		== (off_t) read_bytes;
+}
+
+/* Writes PAGE back to its file if it was modified. */
+static bool
+write_back (struct page *page) {
+	struct file_page *file_page = &page->file;
+	size_t read_bytes = page_read_bytes (page);
+
+	if (!pml4_is_dirty (page->owner->pml4, page->va))
+		return true;
+	return file_write_at (file_page->range->file, page->frame->kva, read_bytes,
+			file_page->range->offset + page_range_ofs (page))
+		== (off_t) read_bytes;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  A clean
+ * page is just dropped: it reads back from the file as it is. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	return write_back (page);
 }
 
-/* Destory the file backed page. PAGE will be freed by the caller. */
+/* Destory the file backed page. PAGE will be freed by the caller.
+ * Writes the page back to the file if the process modified it. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	if (page->frame != NULL) {
+		write_back (page);
+		vm_release_frame (page);
+	}
+}
+
+/* Loads the page of a memory-mapped file, on first access.  AUX is
+ * the page's range. */
+static bool
+lazy_load_file (struct page *page, void *aux) {
+	page->file.range = aux;
+	return file_backed_swap_in (page, page->frame->kva);
 }
 
 /* Do the mmap */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vm_range *range;
+	off_t file_len = file_length (file);
+	size_t read_bytes;
+	uint8_t *va;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || offset < 0
+			|| offset % PGSIZE != 0 || file_len == 0)
+		return NULL;
+	read_bytes = offset < file_len ? (size_t) (file_len - offset) : 0;
+	if (read_bytes > length)
+		read_bytes = length;
+
+	range = spt_add_range (spt, addr, length, RANGE_MMAP, writable, file,
+			offset, read_bytes);
+	if (range == NULL)
+		return NULL;
+	for (va = range->start; va < range->end; va += PGSIZE)
+		if (!vm_alloc_page_with_initializer (VM_FILE, va, writable,
+					lazy_load_file, range)) {
+			spt_remove_range (spt, range);
+			return NULL;
+		}
+	return addr;
 }
 
 /* Do the munmap */
 void
 do_munmap (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vm_range *range = spt_find_range (spt, addr);
+
+	if (range != NULL && range->type == RANGE_MMAP
+			&& range->start == (uint8_t *) addr)
+		spt_remove_range (spt, range);
 }
@@ -1,9 +1,57 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <bitmap.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Caches of `struct page's and `struct frame's. */
+static struct kmem_cache *page_slab;
+static struct kmem_cache *frame_slab;
+
+bool vm_thp = true;
+
+/* Frame table: every frame of user memory, in the order the clock
+   hand sweeps them.  frame_lock protects it and the frames' pin
+   counts and page lists, which may be shared between processes. */
+static struct list frame_table;
+static size_t frame_cnt;            /* Number of frames in the table. */
+static struct list_elem *clock_hand; /* Next frame the clock looks at. */
+static struct lock frame_lock;
+
+/* Eviction statistics. */
+static long long evict_anon;        /* Anonymous pages evicted. */
+static long long evict_file_dirty;  /* File pages written back. */
+static long long evict_file_clean;  /* File pages dropped unwritten. */
+static long long evict_scans;       /* Frames the clock hand passed. */
+static long long swap_readahead_cnt; /* Pages swapped in ahead of faults. */
+
+/* Number of frames an eviction frees at once.  Writing them one
+   after another puts each process's pages in adjacent swap slots,
+   and the spare frames leave room for swap readahead. */
+#define EVICT_BATCH 8
+
+/* Maximum number of pages swapped in along with a faulting one. */
+#define SWAP_READAHEAD 7
+
+/* Copy-on-write statistics. */
+static long long cow_shared;    /* Pages shared by fork(). */
+static long long cow_copied;    /* ...copied on a later write. */
+static long long cow_reused;    /* ...made writable again in place. */
+
+/* Transparent huge page statistics. */
+static long long thp_hits;      /* Regions mapped with a large page. */
+static long long thp_fallbacks; /* Eligible regions without a 2 MB frame. */
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +63,11 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	page_slab = kmem_cache_create ("page", sizeof (struct page), NULL);
+	frame_slab = kmem_cache_create ("frame", sizeof (struct frame), NULL);
+	list_init (&frame_table);
+	clock_hand = list_end (&frame_table);
+	lock_init (&frame_lock);
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -32,11 +84,44 @@ page_get_type (struct page *page) {
 	}
 }
 
+/* Supplemental page table locks that the running thread held
+ * already when it chose an eviction victim: its own and, in
+ * fork(), its parent's. */
+struct held_locks {
+	struct lock *locks[2];
+	size_t cnt;
+};
+
+/* TLB gathers for the address spaces whose entries an eviction
+ * changes, so that each is flushed once rather than page by page. */
+#define EVICT_GATHERS 4
+struct evict_gathers {
+	struct tlb_gather tlbs[EVICT_GATHERS];
+	size_t cnt;
+};
+
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (struct held_locks *,
+		struct evict_gathers *);
 static bool vm_do_claim_page (struct page *page);
 static struct frame *vm_evict_frame (void);
 
+/* Returns a hash value for page P. */
+static uint64_t
+page_hash (const struct hash_elem *p_, void *aux UNUSED) {
+	const struct page *p = hash_entry (p_, struct page, spt_elem);
+	return hash_bytes (&p->va, sizeof p->va);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct page *a = hash_entry (a_, struct page, spt_elem);
+	const struct page *b = hash_entry (b_, struct page, spt_elem);
+	return a->va < b->va;
+}
+
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
  * `vm_alloc_page`. */
@@ -50,11 +135,19 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+		struct page *page = kmem_cache_alloc (page_slab);
+		if (page == NULL)
+			goto err;
+
+		uninit_new (page, upage, init, type, aux,
+				VM_TYPE (type) == VM_FILE
+				? file_backed_initializer : anon_initializer);
+		page->writable = writable;
+		page->owner = thread_current ();
 
-		/* TODO: Insert the page into the spt. */
+		if (spt_insert_page (spt, page))
+			return true;
+		kmem_cache_free (page_slab, page);
 	}
 err:
 	return false;
@@ -62,82 +155,861 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	struct page p;
+	struct hash_elem *e;
 
-	return page;
+	p.va = pg_round_down (va);
+	e = hash_find (&spt->pages, &p.spt_elem);
+	return e != NULL ? hash_entry (e, struct page, spt_elem) : NULL;
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt,
+		struct page *page) {
+	return hash_insert (&spt->pages, &page->spt_elem) == NULL;
 }
 
+/* Removes PAGE from SPT, unmaps and frees it. */
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	lock_acquire (&spt->lock);
+	hash_delete (&spt->pages, &page->spt_elem);
+	if (page->frame != NULL)
+		pml4_clear_page (spt->owner->pml4, page->va);
 	vm_dealloc_page (page);
-	return true;
+	lock_release (&spt->lock);
+}
+
+/* Returns the range of SPT that contains ADDR, or a null pointer
+ * if there is none. */
+struct vm_range *
+spt_find_range (struct supplemental_page_table *spt, const void *addr) {
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->ranges); e != list_end (&spt->ranges);
+			e = list_next (e)) {
+		struct vm_range *range = list_entry (e, struct vm_range, elem);
+		if ((const uint8_t *) addr < range->start)
+			break;
+		if ((const uint8_t *) addr < range->end)
+			return range;
+	}
+	return NULL;
+}
+
+/* Adds to SPT the range of SIZE bytes, rounded up to whole pages,
+ * at page-aligned START.  If FILE is nonnull, the first READ_BYTES
+ * bytes of the range are backed by FILE from OFFSET on; the range
+ * gets its own handle to FILE.
+ * Returns the new range, or a null pointer if it would be empty,
+ * reach outside user space or overlap another range, or if memory
+ * is exhausted. */
+struct vm_range *
+spt_add_range (struct supplemental_page_table *spt, void *start, size_t size,
+		enum vm_range_type type, bool writable,
+		struct file *file, off_t offset, size_t read_bytes) {
+	struct vm_range *range;
+	struct list_elem *e;
+	uint8_t *end;
+
+	ASSERT (pg_ofs (start) == 0);
+
+	if (size == 0 || !is_user_vaddr (start)
+			|| size > KERN_BASE - (uint64_t) start)
+		return NULL;
+	end = (uint8_t *) start + ROUND_UP (size, PGSIZE);
+
+	/* Find the first range past the new one, making sure that no
+	   range before it overlaps. */
+	for (e = list_begin (&spt->ranges); e != list_end (&spt->ranges);
+			e = list_next (e)) {
+		struct vm_range *next = list_entry (e, struct vm_range, elem);
+		if (end <= next->start)
+			break;
+		if ((uint8_t *) start < next->end)
+			return NULL;
+	}
+
+	range = malloc (sizeof *range);
+	if (range == NULL)
+		return NULL;
+	range->start = start;
+	range->end = end;
+	range->type = type;
+	range->writable = writable;
+	range->file = NULL;
+	range->offset = offset;
+	range->read_bytes = read_bytes;
+	if (file != NULL && (range->file = file_reopen (file)) == NULL) {
+		free (range);
+		return NULL;
+	}
+	list_insert (e, &range->elem);
+	return range;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Removes RANGE, which must hold no pages anymore, from its
+ * supplemental page table and frees it. */
+static void
+range_free (struct vm_range *range) {
+	list_remove (&range->elem);
+	file_close (range->file);
+	free (range);
+}
+
+/* Removes RANGE and all of its pages from SPT.  Modified pages of
+ * a memory-mapped file are written back to the file. */
+void
+spt_remove_range (struct supplemental_page_table *spt,
+		struct vm_range *range) {
+	struct tlb_gather tlb;
+	uint8_t *va;
+
+	/* Unmap first, flushing the TLB once, and only then free the
+	   frames. */
+	lock_acquire (&spt->lock);
+	tlb_gather_init (&tlb, spt->owner->pml4);
+	for (va = range->start; va < range->end; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		if (page != NULL && page->frame != NULL)
+			tlb_gather_clear_page (&tlb, va);
+	}
+	tlb_gather_finish (&tlb);
+
+	for (va = range->start; va < range->end; va += PGSIZE) {
+		struct page *page = spt_find_page (spt, va);
+		if (page != NULL) {
+			hash_delete (&spt->pages, &page->spt_elem);
+			vm_dealloc_page (page);
+		}
+	}
+	range_free (range);
+	lock_release (&spt->lock);
+}
+
+/* Returns a new frame for the page of memory at KVA, or a null
+ * pointer if memory is exhausted. */
 static struct frame *
-vm_get_victim (void) {
-	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+frame_new (void *kva) {
+	struct frame *frame = kmem_cache_alloc (frame_slab);
+
+	if (frame != NULL) {
+		frame->kva = kva;
+		frame->page = NULL;
+		list_init (&frame->pages);
+		frame->pin_cnt = 0;
+	}
+	return frame;
+}
+
+/* Adds FRAME to the frame table, just behind the clock hand, so
+ * that it is looked at last.  The caller must hold frame_lock. */
+static void
+frame_table_insert (struct frame *frame) {
+	list_insert (clock_hand, &frame->elem);
+	frame_cnt++;
+}
+
+/* Removes FRAME from the frame table.  The caller must hold
+ * frame_lock. */
+static void
+frame_table_remove (struct frame *frame) {
+	if (clock_hand == &frame->elem)
+		clock_hand = list_next (clock_hand);
+	list_remove (&frame->elem);
+	frame_cnt--;
+}
+
+/* Removes FRAME, which no page maps, from the frame table and
+ * frees it. */
+static void
+frame_free (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	frame_table_remove (frame);
+	lock_release (&frame_lock);
+	palloc_free_page (frame->kva);
+	kmem_cache_free (frame_slab, frame);
+}
+
+/* Keeps FRAME from being evicted until frame_unpin(). */
+static void
+frame_pin (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	frame->pin_cnt++;
+	lock_release (&frame_lock);
+}
+
+/* Undoes one frame_pin() of FRAME, or the pin that vm_get_frame()
+ * returns it with. */
+static void
+frame_unpin (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	ASSERT (frame->pin_cnt > 0);
+	frame->pin_cnt--;
+	lock_release (&frame_lock);
+}
+
+/* Adds PAGE to the pages mapping FRAME.  The caller must hold
+ * frame_lock if other processes may see FRAME. */
+static void
+frame_link (struct frame *frame, struct page *page) {
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->page = list_entry (list_front (&frame->pages),
+			struct page, frame_elem);
+	page->frame = frame;
+}
+
+/* Removes PAGE from the pages mapping its frame.  Returns true if
+ * no page maps the frame anymore.  The caller must hold frame_lock
+ * if other processes may see the frame. */
+static bool
+frame_unlink (struct page *page) {
+	struct frame *frame = page->frame;
+
+	list_remove (&page->frame_elem);
+	page->frame = NULL;
+	if (list_empty (&frame->pages)) {
+		frame->page = NULL;
+		return true;
+	}
+	frame->page = list_entry (list_front (&frame->pages),
+			struct page, frame_elem);
+	return false;
+}
+
+/* Returns true if more than one page maps FRAME. */
+static bool
+frame_is_shared (struct frame *frame) {
+	return list_front (&frame->pages) != list_back (&frame->pages);
+}
+
+/* Detaches PAGE from its frame, and frees the frame if no other
+ * page maps it.  Called by the destroy operations, since
+ * vm_dealloc_page() frees only the page. */
+void
+vm_release_frame (struct page *page) {
+	struct frame *frame = page->frame;
+	bool last;
+
+	lock_acquire (&frame_lock);
+	last = frame_unlink (page);
+	if (last)
+		frame_table_remove (frame);
+	lock_release (&frame_lock);
+	if (last) {
+		palloc_free_page (frame->kva);
+		kmem_cache_free (frame_slab, frame);
+	}
+}
+/* Returns the lock on the supplemental page table of the owner
+ * of the page at E in a frame's list of pages. */
+static struct lock *
+page_owner_lock (struct list_elem *e) {
+	return &list_entry (e, struct page, frame_elem)->owner->spt.lock;
+}
+
+/* Returns true if LOCK is one of HELD. */
+static bool
+held_locks_contain (const struct held_locks *held, const struct lock *lock) {
+	for (size_t i = 0; i < held->cnt; i++)
+		if (held->locks[i] == lock)
+			return true;
+	return false;
+}
+
+/* Releases the locks on the owners of the pages mapping FRAME,
+ * from the first page up to END, except those in HELD. */
+static void
+frame_unlock_owners (struct frame *frame, const struct held_locks *held,
+		struct list_elem *end) {
+	for (struct list_elem *e = list_begin (&frame->pages); e != end;
+			e = list_next (e))
+		if (!held_locks_contain (held, page_owner_lock (e)))
+			lock_release (page_owner_lock (e));
+}
+
+/* Locks the supplemental page tables of the owners of all pages
+ * mapping FRAME, without waiting: an owner may be waiting for a
+ * frame itself.  Those the running thread holds already are
+ * recorded in HELD instead.  Returns false, holding none of the
+ * locks it took, if one of them is busy.  The caller must hold
+ * frame_lock. */
+static bool
+frame_lock_owners (struct frame *frame, struct held_locks *held) {
+	struct list_elem *e;
+
+	held->cnt = 0;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct lock *lock = page_owner_lock (e);
+
+		if (!lock_held_by_current_thread (lock)) {
+			if (!lock_try_acquire (lock))
+				break;
+		} else if (held->cnt < sizeof held->locks / sizeof *held->locks)
+			held->locks[held->cnt++] = lock;
+		else
+			break;
+	}
+	if (e == list_end (&frame->pages))
+		return true;
+	frame_unlock_owners (frame, held, e);
+	return false;
+}
+
+/* Returns GATHERS' TLB gather for PML4, finishing all of them
+ * first if there is no room for another address space. */
+static struct tlb_gather *
+evict_gather (struct evict_gathers *gathers, uint64_t *pml4) {
+	for (size_t i = 0; i < gathers->cnt; i++)
+		if (gathers->tlbs[i].pml4 == pml4)
+			return &gathers->tlbs[i];
+	if (gathers->cnt == EVICT_GATHERS) {
+		for (size_t i = 0; i < gathers->cnt; i++)
+			tlb_gather_finish (&gathers->tlbs[i]);
+		gathers->cnt = 0;
+	}
+	tlb_gather_init (&gathers->tlbs[gathers->cnt], pml4);
+	return &gathers->tlbs[gathers->cnt++];
+}
+
+/* Flushes the TLB entries gathered in GATHERS.  This must happen
+ * before frame_lock is released: until then, every address space
+ * with a gathered page still has a frame linked, so process exit
+ * cannot have destroyed its page map. */
+static void
+evict_gathers_finish (struct evict_gathers *gathers) {
+	for (size_t i = 0; i < gathers->cnt; i++)
+		tlb_gather_finish (&gathers->tlbs[i]);
+	gathers->cnt = 0;
+}
+
+/* Returns true if any page mapping FRAME was accessed since the
+ * clock hand last passed, and clears their accessed bits, leaving
+ * the TLB flush to GATHERS.  A stale TLB entry only keeps the CPU
+ * from setting the bit again until the flush.  The owners of the
+ * pages must be locked. */
+static bool
+frame_test_accessed (struct frame *frame, struct evict_gathers *gathers) {
+	bool accessed = false;
+
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		if (tlb_gather_clear_accessed (
+					evict_gather (gathers, page->owner->pml4), page->va))
+			accessed = true;
+	}
+	return accessed;
+}
+
+/* Get the struct frame, that will be evicted: the clock, or
+ * second-chance, policy.  The hand sweeps the frame table and
+ * gives a frame any of whose pages was accessed since the hand
+ * last passed a second chance, clearing the accessed bits instead
+ * and gathering their TLB flushes in GATHERS.
+ * Frames that are pinned, or one of whose owners is busy with its
+ * address space, are passed over.
+ * The caller must hold frame_lock.  Returns the victim pinned,
+ * with the supplemental page tables of all its pages' owners
+ * locked, and records in HELD those of the locks the running
+ * thread held already; returns a null pointer if two sweeps found
+ * nothing. */
+static struct frame *
+vm_get_victim (struct held_locks *held, struct evict_gathers *gathers) {
+	for (size_t i = 0; i < 2 * frame_cnt; i++) {
+		struct frame *frame;
+
+		if (clock_hand == list_end (&frame_table))
+			clock_hand = list_begin (&frame_table);
+		frame = list_entry (clock_hand, struct frame, elem);
+		clock_hand = list_next (clock_hand);
+		evict_scans++;
+
+		if (frame->pin_cnt > 0 || frame->page == NULL
+				|| !frame_lock_owners (frame, held))
+			continue;
+		if (frame_test_accessed (frame, gathers)) {
+			frame_unlock_owners (frame, held, list_end (&frame->pages));
+			continue;
+		}
+		frame->pin_cnt++;
+		return frame;
+	}
+	return NULL;
+}
+
+/* Unmaps every page that maps FRAME, an eviction victim, so that
+ * the owners fault, and wait for their locks, instead of changing
+ * the frame while it is written out.  The TLB flushes are left to
+ * GATHERS.  The caller must hold frame_lock. */
+static void
+frame_unmap (struct frame *frame, struct evict_gathers *gathers) {
+	for (struct list_elem *e = list_begin (&frame->pages);
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		tlb_gather_clear_page (evict_gather (gathers, page->owner->pml4),
+				page->va);
+	}
+}
+
+/* Maps PAGE, which frame_unmap() unmapped, to its frame again,
+ * keeping its dirty bit. */
+static void
+page_remap (struct page *page) {
+	uint64_t *pml4 = page->owner->pml4;
+	bool dirty = pml4_is_dirty (pml4, page->va);
+	bool writable;
+
+	/* Pages that still share the frame stay read-only. */
+	lock_acquire (&frame_lock);
+	writable = page->writable && !frame_is_shared (page->frame);
+	lock_release (&frame_lock);
+	pml4_set_page (pml4, page->va, page->frame->kva, writable);
+	if (dirty)
+		pml4_set_dirty (pml4, page->va, true);
+}
+
+/* Writes PAGE, which maps the eviction victim and was unmapped by
+ * frame_unmap(), out and detaches it from the frame.  Clean
+ * file-backed pages are just dropped.  Returns false, mapping
+ * PAGE again, if it cannot be written out. */
+static bool
+evict_page (struct page *page) {
+	bool dirty = pml4_is_dirty (page->owner->pml4, page->va);
+
+	if (!swap_out (page)) {
+		page_remap (page);
+		return false;
+	}
 
-	return victim;
+	if (VM_TYPE (page->operations->type) == VM_ANON)
+		evict_anon++;
+	else if (dirty)
+		evict_file_dirty++;
+	else
+		evict_file_clean++;
+
+	lock_acquire (&frame_lock);
+	frame_unlink (page);
+	lock_release (&frame_lock);
+	return true;
+}
+
+/* Evicts FRAME, the victim, from every page that maps it, and
+ * releases the locks that vm_get_victim() took on their owners,
+ * that is, all but those in HELD.  A frame that fork() left shared is
+ * written out once for each page, so that each process swaps its
+ * own copy back in.  The data cannot change in between, since all
+ * the pages are unmapped and their owners are locked.
+ * Returns false if a page cannot be written out; that page and
+ * the ones after it keep the frame, and are mapped again. */
+static bool
+evict_frame (struct frame *frame, const struct held_locks *held) {
+	struct list_elem *e = list_begin (&frame->pages);
+	bool success = true;
+
+	while (e != list_end (&frame->pages)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+		struct lock *lock = page_owner_lock (e);
+
+		e = list_next (e);
+		if (success)
+			success = evict_page (page);
+		else
+			page_remap (page);
+		if (!held_locks_contain (held, lock))
+			lock_release (lock);
+	}
+	return success;
 }
 
-/* Evict one page and return the corresponding frame.
+/* Evict one page and return the corresponding frame, pinned.
+ * Evicts up to EVICT_BATCH - 1 more pages along with it and frees
+ * their frames.  All the victims are chosen and unmapped first,
+ * with one TLB flush per address space for the whole batch, and
+ * only then written out.  Their owners stay locked until then;
+ * the victims are written out in the reverse order of their
+ * choosing, so that a lock the running thread took for one victim
+ * outlives the later victims that found it held.
  * Return NULL on error.*/
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victims[EVICT_BATCH];
+	struct held_locks held[EVICT_BATCH];
+	struct evict_gathers gathers;
+	struct frame *kept = NULL;
+	size_t cnt;
 
-	return NULL;
+	gathers.cnt = 0;
+	lock_acquire (&frame_lock);
+	for (cnt = 0; cnt < EVICT_BATCH; cnt++) {
+		victims[cnt] = vm_get_victim (&held[cnt], &gathers);
+		if (victims[cnt] == NULL)
+			break;
+		frame_unmap (victims[cnt], &gathers);
+	}
+	evict_gathers_finish (&gathers);
+	lock_release (&frame_lock);
+
+	while (cnt-- > 0) {
+		struct frame *victim = victims[cnt];
+
+		if (!evict_frame (victim, &held[cnt]))
+			frame_unpin (victim);
+		else if (kept == NULL)
+			kept = victim;
+		else
+			frame_free (victim);
+	}
+	return kept;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it.  The frame is zeroed, in the frame table and pinned
+ * until frame_unpin(), so that it is not evicted while it is filled.
+ * Returns a null pointer if no frame can be freed either. */
 static struct frame *
 vm_get_frame (void) {
-	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	struct frame *frame;
+	void *kva = palloc_get_page (PAL_USER | PAL_ZERO);
 
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	if (kva == NULL) {
+		frame = vm_evict_frame ();
+		if (frame != NULL)
+			memset (frame->kva, 0, PGSIZE);
+		return frame;
+	}
+	frame = frame_new (kva);
+	if (frame == NULL) {
+		palloc_free_page (kva);
+		return NULL;
+	}
+	frame->pin_cnt = 1;
+	lock_acquire (&frame_lock);
+	frame_table_insert (frame);
+	lock_release (&frame_lock);
 	return frame;
 }
 
 /* Growing the stack. */
+static bool
+vm_stack_growth (void *addr) {
+	return vm_alloc_page (VM_ANON | VM_MARKER_0, pg_round_down (addr), true);
+}
+
+/* Handle the fault on write_protected page: the first write to a
+ * page that fork() left shared with another process.  The page
+ * gets a copy of the frame, or keeps the frame if no other page
+ * maps it anymore, and is mapped writable. */
+static bool
+vm_handle_wp (struct page *page) {
+	struct frame *old = page->frame;
+	struct frame *new = NULL;
+	bool shared, success;
+
+	/* A frame is only ever shared more widely by fork() of its
+	   owner, that is, not while we are here, so it is safe to
+	   allocate the copy without holding the lock, which getting a
+	   frame may need.  OLD stays pinned meanwhile, since getting a
+	   frame may evict. */
+	lock_acquire (&frame_lock);
+	shared = frame_is_shared (old);
+	old->pin_cnt++;
+	lock_release (&frame_lock);
+	if (shared && (new = vm_get_frame ()) == NULL) {
+		frame_unpin (old);
+		return false;
+	}
+
+	lock_acquire (&frame_lock);
+	old->pin_cnt--;
+	if (new != NULL && frame_is_shared (old)) {
+		memcpy (new->kva, old->kva, PGSIZE);
+		frame_unlink (page);
+		frame_link (new, page);
+		cow_copied++;
+	} else
+		cow_reused++;
+	lock_release (&frame_lock);
+
+	if (new != NULL && new->page == NULL) {
+		frame_free (new);
+		new = NULL;
+	}
+	success = pml4_set_page (thread_current ()->pml4, page->va,
+			page->frame->kva, true);
+	if (new != NULL)
+		frame_unpin (new);
+	return success;
+}
+
+/* Returns true if PAGE can be part of a transparent huge page
+ * mapped WRITABLE: a zero-fill anonymous page that was never
+ * claimed. */
+static bool
+thp_page_ok (const struct page *page, bool writable) {
+	return page != NULL && page->frame == NULL
+		&& VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL
+		&& page->writable == writable;
+}
+
+/* Unlinks and frees the frames of the first CNT pages from BASE,
+ * but not the memory they describe. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+thp_unclaim (struct supplemental_page_table *spt, uint8_t *base, size_t cnt) {
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *page = spt_find_page (spt, base + i * PGSIZE);
+		struct frame *frame = page->frame;
+
+		frame_unlink (page);
+		kmem_cache_free (frame_slab, frame);
+	}
 }
 
-/* Handle the fault on write_protected page */
+/* Transparent huge pages.  A fault in a 2 MB aligned region whose
+ * pages are all unclaimed zero-fill anonymous pages claims the
+ * whole region at once: it is backed by one physically contiguous
+ * 2 MB frame and mapped with a single large-page entry, which
+ * saves 511 faults and lets one TLB entry cover the region.
+ * Every page keeps its own frame, pointing into the large one, so
+ * the rest of the VM handles the pages one by one as usual; the
+ * MMU splits the mapping into 4 kB entries as soon as one of them
+ * is unmapped or remapped on its own, e.g. by munmap(),
+ * copy-on-write or eviction.
+ * Returns false if the region does not qualify or no 2 MB frame
+ * is free, in which case the caller claims just the faulting
+ * page. */
 static bool
-vm_handle_wp (struct page *page UNUSED) {
+vm_try_huge_fault (struct supplemental_page_table *spt, void *addr) {
+	uint8_t *base = (uint8_t *) ((uint64_t) addr & ~(LARGE_PGSIZE - 1));
+	const size_t page_cnt = LARGE_PGSIZE / PGSIZE;
+	struct page *page;
+	uint8_t *kva;
+	bool writable;
+
+	if (!vm_thp || base == NULL
+			|| !is_user_vaddr (base + LARGE_PGSIZE - 1))
+		return false;
+
+	/* Cheap checks on the faulting page and the region's ends
+	   first, since they reject most regions. */
+	page = spt_find_page (spt, pg_round_down (addr));
+	if (page == NULL)
+		return false;
+	writable = page->writable;
+	if (!thp_page_ok (page, writable)
+			|| !thp_page_ok (spt_find_page (spt, base), writable)
+			|| !thp_page_ok (spt_find_page (spt,
+					base + LARGE_PGSIZE - PGSIZE), writable))
+		return false;
+	for (size_t i = 1; i < page_cnt - 1; i++)
+		if (!thp_page_ok (spt_find_page (spt, base + i * PGSIZE), writable))
+			return false;
+
+	/* The buddy allocator aligns a block of 512 pages to 2 MB. */
+	kva = palloc_get_multiple (PAL_USER | PAL_ZERO, page_cnt);
+	if (kva == NULL) {
+		thp_fallbacks++;
+		return false;
+	}
+	ASSERT (vtop (kva) % LARGE_PGSIZE == 0);
+
+	for (size_t i = 0; i < page_cnt; i++) {
+		struct frame *frame = frame_new (kva + i * PGSIZE);
+		if (frame == NULL) {
+			thp_unclaim (spt, base, i);
+			goto fail;
+		}
+		frame_link (frame, spt_find_page (spt, base + i * PGSIZE));
+	}
+	if (!pml4_set_large_page (thread_current ()->pml4, base, kva, writable)) {
+		thp_unclaim (spt, base, page_cnt);
+		goto fail;
+	}
+
+	/* Initializing a zero-fill anonymous page reads nothing, so
+	   it cannot fail. */
+	lock_acquire (&frame_lock);
+	for (size_t i = 0; i < page_cnt; i++) {
+		page = spt_find_page (spt, base + i * PGSIZE);
+		swap_in (page, page->frame->kva);
+		frame_table_insert (page->frame);
+	}
+	lock_release (&frame_lock);
+	thp_hits++;
+	return true;
+
+fail:
+	palloc_free_multiple (kva, page_cnt);
+	thp_fallbacks++;
+	return false;
+}
+
+/* Handles a fault at ADDR in the address space of the running
+ * process, whose supplemental page table SPT is locked.  F is null
+ * for faults that the kernel provokes on purpose, which are never
+ * user faults. */
+static bool
+handle_fault (struct supplemental_page_table *spt, struct intr_frame *f,
+		void *addr, bool user, bool write, bool not_present) {
+	struct thread *curr = thread_current ();
+	struct page *page;
+
+	if (addr == NULL || !is_user_vaddr (addr))
+		return false;
+	page = spt_find_page (spt, addr);
+
+	/* A write to a present read-only page is fine only if the page
+	   itself is writable and fork() shares it. */
+	if (!not_present)
+		return write && page != NULL && page->writable && vm_handle_wp (page);
+
+	/* Grow the stack for accesses at or above the stack pointer,
+	   allowing for PUSH, which faults 8 bytes below it.  The user's
+	   stack pointer is in F only if the fault happened in user
+	   mode. */
+	if (page == NULL) {
+		uint8_t *rsp = (uint8_t *) (user ? f->rsp : curr->user_rsp);
+		struct vm_range *range = spt_find_range (spt, addr);
+
+		if (range == NULL || range->type != RANGE_STACK
+				|| (uint8_t *) addr < rsp - 8 || !vm_stack_growth (addr))
+			return false;
+		page = spt_find_page (spt, addr);
+	}
+	if (write && !page->writable)
+		return false;
+
+	/* The page lost its mapping together with the rest of its
+	   large page when splitting that failed. */
+	if (page->frame != NULL) {
+		bool writable;
+
+		lock_acquire (&frame_lock);
+		writable = page->writable && !frame_is_shared (page->frame);
+		lock_release (&frame_lock);
+		return pml4_set_page (curr->pml4, page->va, page->frame->kva, writable);
+	}
+
+	if (vm_try_huge_fault (spt, addr))
+		return true;
+	return vm_do_claim_page (page);
 }
 
 /* Return true on success */
 bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	bool success;
 
-	return vm_do_claim_page (page);
+	lock_acquire (&spt->lock);
+	success = handle_fault (spt, f, addr, user, write, not_present);
+	lock_release (&spt->lock);
+	return success;
+}
+
+/* Faults in the SIZE bytes of user memory at UADDR, making them
+ * writable if WRITE, and pins their frames if PIN.  SPT is the
+ * running process's supplemental page table, which must be locked.
+ * On failure, pins nothing. */
+static bool
+prefault (struct supplemental_page_table *spt, const void *uaddr,
+		size_t size, bool write, bool pin) {
+	const uint8_t *end = (const uint8_t *) uaddr + size;
+	const uint8_t *p;
+
+	if (size == 0)
+		return true;
+	if (end < (const uint8_t *) uaddr || !is_user_vaddr (end - 1))
+		return false;
+	for (p = pg_round_down (uaddr); p < end; p += PGSIZE) {
+		void *addr = (void *) (p < (const uint8_t *) uaddr ? uaddr : p);
+		struct page *page = spt_find_page (spt, addr);
+		bool ok = true;
+
+		if (page == NULL || page->frame == NULL)
+			ok = handle_fault (spt, NULL, addr, false, write, true);
+		else if (write)
+			ok = page->writable
+				&& (!frame_is_shared (page->frame) || vm_handle_wp (page));
+		if (!ok) {
+			if (pin && p > (const uint8_t *) pg_round_down (uaddr))
+				vm_unpin (uaddr, p - (const uint8_t *) uaddr);
+			return false;
+		}
+		if (pin)
+			frame_pin (spt_find_page (spt, addr)->frame);
+	}
+	return true;
+}
+
+/* Makes sure that the SIZE bytes of user memory at UADDR are
+ * mapped, and writable if WRITE, so that the kernel can access
+ * them without faulting.  Returns false if they are not valid user
+ * memory.  They may be evicted again at any time. */
+bool
+vm_prefault (const void *uaddr, size_t size, bool write) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	bool success;
+
+	lock_acquire (&spt->lock);
+	success = prefault (spt, uaddr, size, write, false);
+	lock_release (&spt->lock);
+	return success;
+}
+
+/* Like vm_prefault(), but also keeps the memory from being evicted
+ * until vm_unpin(), so that the kernel can access it while it holds
+ * a lock that handling a fault could need, e.g. while the file
+ * system reads from disk straight into it. */
+bool
+vm_pin (const void *uaddr, size_t size, bool write) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	bool success;
+
+	lock_acquire (&spt->lock);
+	success = prefault (spt, uaddr, size, write, true);
+	lock_release (&spt->lock);
+	return success;
+}
+
+/* Undoes vm_pin (UADDR, SIZE, ...). */
+void
+vm_unpin (const void *uaddr, size_t size) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	const uint8_t *end = (const uint8_t *) uaddr + size;
+	const uint8_t *p;
+
+	if (size == 0)
+		return;
+	for (p = pg_round_down (uaddr); p < end; p += PGSIZE)
+		frame_unpin (spt_find_page (spt, (void *) p)->frame);
+}
+
+/* Prints transparent huge page, copy-on-write and eviction
+ * statistics. */
+void
+vm_print_stats (void) {
+	long long evictions = evict_anon + evict_file_dirty + evict_file_clean;
+
+	printf ("VM: %lld huge page faults, %lld fallbacks, %lld splits\n",
+			thp_hits, thp_fallbacks, pml4_split_cnt ());
+	printf ("VM: %lld pages shared by fork, %lld copied, %lld reused\n",
+			cow_shared, cow_copied, cow_reused);
+	printf ("VM: %lld evictions (%lld anonymous, %lld file written back, "
+			"%lld file dropped), %lld frames scanned per eviction\n",
+			evictions, evict_anon, evict_file_dirty, evict_file_clean,
+			evictions > 0 ? evict_scans / evictions : 0);
+	printf ("VM: %lld pages read ahead from swap\n", swap_readahead_cnt);
+	anon_print_stats ();
 }
 
 /* Free the page.
@@ -150,41 +1022,244 @@ vm_dealloc_page (struct page *page) {
 
 /* Claim the page that allocate on VA. */
 bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+vm_claim_page (void *va) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page;
+	bool success;
 
-	return vm_do_claim_page (page);
+	lock_acquire (&spt->lock);
+	page = spt_find_page (spt, va);
+	success = page != NULL && vm_do_claim_page (page);
+	lock_release (&spt->lock);
+	return success;
 }
 
-/* Claim the PAGE and set up the mmu. */
+/* Swap readahead: swaps in the CNT PAGES, which are swapped out
+ * and belong to a process whose supplemental page table is
+ * locked, as long as there are free frames.  Readahead never
+ * evicts.  The pages are mapped with their accessed bits clear, so
+ * that the clock hand takes those that go unused first. */
+static void
+swap_readahead (struct page *pages[], size_t cnt) {
+	for (size_t i = 0; i < cnt; i++) {
+		struct page *page = pages[i];
+		void *kva = palloc_get_page (PAL_USER);
+		struct frame *frame;
+
+		if (kva == NULL)
+			return;
+		frame = frame_new (kva);
+		if (frame == NULL) {
+			palloc_free_page (kva);
+			return;
+		}
+
+		/* Map before reading, which frees the swap slot, so that
+		   failing leaves the page in swap.  The owner cannot run
+		   meanwhile. */
+		frame_link (frame, page);
+		if (!pml4_set_page (page->owner->pml4, page->va, kva, page->writable)) {
+			frame_unlink (page);
+			kmem_cache_free (frame_slab, frame);
+			palloc_free_page (kva);
+			return;
+		}
+		swap_in (page, kva);
+		lock_acquire (&frame_lock);
+		frame_table_insert (frame);
+		lock_release (&frame_lock);
+		swap_readahead_cnt++;
+	}
+}
+
+/* Claim the PAGE and set up the mmu.  The page is filled before
+ * it is mapped, so that the process never sees it half loaded.
+ * PAGE's owner, which need not be the running process, must have
+ * its supplemental page table locked. */
 static bool
 vm_do_claim_page (struct page *page) {
+	struct page *ahead[SWAP_READAHEAD];
+	size_t ahead_cnt = 0;
 	struct frame *frame = vm_get_frame ();
 
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	if (frame == NULL)
+		return false;
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+	/* Look for pages to read ahead while PAGE still has its swap
+	   slot. */
+	if (VM_TYPE (page->operations->type) == VM_ANON
+			&& page->anon.slot != BITMAP_ERROR)
+		ahead_cnt = anon_swap_neighbors (page, ahead, SWAP_READAHEAD);
 
-	return swap_in (page, frame->kva);
+	/* Set links */
+	frame_link (frame, page);
+
+	if (!swap_in (page, frame->kva)
+			|| !pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable)) {
+		vm_release_frame (page);
+		return false;
+	}
+	frame_unpin (frame);
+	swap_readahead (ahead, ahead_cnt);
+	return true;
 }
 
 /* Initialize new supplemental page table */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	spt->owner = thread_current ();
+	lock_init (&spt->lock);
+	spt->swap_next = spt->swap_left = 0;
+	hash_init (&spt->pages, page_hash, page_less, NULL);
+	list_init (&spt->ranges);
+}
+
+/* Gives the running process, whose supplemental page table is
+ * DST, a copy of the parent's page PAGE.  Anonymous pages in
+ * memory are shared until either process writes them: both map
+ * the frame read-only, the parent's entry being changed through
+ * TLB.  Both supplemental page tables must be locked. */
+static bool
+copy_page (struct supplemental_page_table *dst, struct page *page,
+		struct tlb_gather *tlb) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct page *copy;
+	uint64_t *pte;
+
+	if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+		struct uninit_page *uninit = &page->uninit;
+		return vm_alloc_page_with_initializer (uninit->type, page->va,
+				page->writable, uninit->init,
+				uninit->init != NULL ? spt_find_range (dst, page->va) : NULL);
+	}
+
+	/* Bring a swapped-out anonymous page back in to share it. */
+	if (page->frame == NULL && VM_TYPE (page->operations->type) == VM_ANON
+			&& !vm_do_claim_page (page))
+		return false;
+
+	/* From here on, DST's destruction cleans up after failures. */
+	copy = kmem_cache_alloc (page_slab);
+	if (copy == NULL)
+		return false;
+	*copy = *page;
+	copy->owner = thread_current ();
+	copy->frame = NULL;
+	if (!spt_insert_page (dst, copy)) {
+		kmem_cache_free (page_slab, copy);
+		return false;
+	}
+
+	if (VM_TYPE (page->operations->type) == VM_FILE) {
+		struct frame *frame;
+
+		/* An evicted page reads back from the file, where the
+		   parent's changes are.  Getting a frame may evict the
+		   parent's page. */
+		copy->file.range = spt_find_range (dst, page->va);
+		if (page->frame == NULL)
+			return true;
+		frame_pin (page->frame);
+		frame = vm_get_frame ();
+		if (frame != NULL)
+			memcpy (frame->kva, page->frame->kva, PGSIZE);
+		frame_unpin (page->frame);
+		if (frame == NULL)
+			return false;
+		frame_link (frame, copy);
+		frame_unpin (frame);
+		return pml4_set_page (pml4, copy->va, frame->kva, copy->writable);
+	}
+
+	lock_acquire (&frame_lock);
+	frame_link (page->frame, copy);
+	lock_release (&frame_lock);
+	if (!pml4_set_page (pml4, copy->va, copy->frame->kva, false))
+		return false;
+	if (page->writable) {
+		pte = pml4e_walk (tlb->pml4, (uint64_t) page->va, true);
+		if (pte == NULL)
+			return false;
+		if (*pte & PTE_W) {
+			*pte &= ~PTE_W;
+			tlb_gather_add (tlb, page->va);
+		}
+	}
+	cow_shared++;
+	return true;
 }
 
 /* Copy supplemental page table from src to dst */
 bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	struct tlb_gather tlb;
+	struct hash_iterator i;
+	struct list_elem *e;
+	bool success = true;
+
+	ASSERT (dst == &thread_current ()->spt);
+
+	lock_acquire (&dst->lock);
+	lock_acquire (&src->lock);
+	for (e = list_begin (&src->ranges); e != list_end (&src->ranges);
+			e = list_next (e)) {
+		struct vm_range *r = list_entry (e, struct vm_range, elem);
+		if (spt_add_range (dst, r->start, r->end - r->start, r->type,
+					r->writable, r->file, r->offset, r->read_bytes) == NULL) {
+			success = false;
+			break;
+		}
+	}
+
+	tlb_gather_init (&tlb, src->owner->pml4);
+	if (success) {
+		hash_first (&i, &src->pages);
+		while (success && hash_next (&i))
+			success = copy_page (dst,
+					hash_entry (hash_cur (&i), struct page, spt_elem), &tlb);
+	}
+	tlb_gather_finish (&tlb);
+	lock_release (&src->lock);
+	lock_release (&dst->lock);
+	return success;
 }
 
-/* Free the resource hold by the supplemental page table */
+/* Frees page E of a supplemental page table. */
+static void
+page_destructor (struct hash_elem *e, void *aux UNUSED) {
+	vm_dealloc_page (hash_entry (e, struct page, spt_elem));
+}
+
+/* Free the resource hold by the supplemental page table, writing
+ * modified pages of memory-mapped files back.  SPT is left empty,
+ * ready for the next program, as process_exec() needs. */
 void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	uint64_t *pml4 = spt->owner->pml4;
+	struct hash_iterator i;
+
+	lock_acquire (&spt->lock);
+
+	/* Unmap everything first, so that pml4_destroy() does not free
+	   the frames again, flushing the TLB once. */
+	if (pml4 != NULL) {
+		struct tlb_gather tlb;
+
+		tlb_gather_init (&tlb, pml4);
+		hash_first (&i, &spt->pages);
+		while (hash_next (&i)) {
+			struct page *page = hash_entry (hash_cur (&i), struct page, spt_elem);
+			if (page->frame != NULL)
+				tlb_gather_clear_page (&tlb, page->va);
+		}
+		tlb_gather_finish (&tlb);
+	}
+
+	hash_clear (&spt->pages, page_destructor);
+	anon_release_slots (spt);
+	while (!list_empty (&spt->ranges))
+		range_free (list_entry (list_front (&spt->ranges), struct vm_range, elem));
+	lock_release (&spt->lock);
 }